@@ -69,6 +69,9 @@ namespace study_cases {
 		cout << "        euler:      Euler integration method. Numerically unstable." << endl;
 		cout << "        semi-euler: Euler semi-implicit integration method. Numerically stable." << endl;
 		cout << "        verlet:     Verlet integration method. Numerically even more stable." << endl;
+		cout << "        velocity-verlet: velocity Verlet integration method." << endl;
+		cout << "        leapfrog:   leapfrog (drift-kick-drift) integration method." << endl;
+		cout << "        rk4:        fourth order Runge-Kutta integration method." << endl;
 		cout << "    --print:        Print trajectory of particles.        Default: do not print" << endl;
 		cout << endl;
 		cout << "    [-o|--output]:  store the particle's trajectory in the specified file." << endl;
@@ -109,6 +112,15 @@ namespace study_cases {
 				else if (solv_name == "verlet") {
 					solv = solver_type::Verlet;
 				}
+				else if (solv_name == "velocity-verlet") {
+					solv = solver_type::VelocityVerlet;
+				}
+				else if (solv_name == "leapfrog") {
+					solv = solver_type::Leapfrog;
+				}
+				else if (solv_name == "rk4") {
+					solv = solver_type::RK4;
+				}
 				else {
 					cerr << "Error: invalid value for solver." << endl;
 					return;
@@ -56,11 +56,16 @@ namespace study_cases {
 		cout << "        euler:      Euler integration method.." << endl;
 		cout << "        semi-euler: Euler semi-implicit integration method." << endl;
 		cout << "        verlet:     Verlet integration method." << endl;
+		cout << "        velocity-verlet: velocity Verlet integration method." << endl;
+		cout << "        leapfrog:   leapfrog (drift-kick-drift) integration method." << endl;
+		cout << "        rk4:        fourth order Runge-Kutta integration method." << endl;
 		cout << "    -n k:           number of rows of the regular mesh.   Default: 5" << endl;
 		cout << "    -m k:           number of columns of the regular mesh.   Default: 5" << endl;
 		cout << "    --bend:         activate bend forces" << endl;
 		cout << "    --shear:        activate shear forces" << endl;
 		cout << "    --stretch:      activate stretch forces" << endl;
+		cout << "    --implicit:     integrate the mesh with implicit Euler" << endl;
+		cout << "    --pbd:          simulate the mesh with position-based dynamics" << endl;
 		cout << endl;
 	}
 
@@ -73,6 +78,8 @@ namespace study_cases {
 		bool shear = false;
 		bool stretch = false;
 		bool bend = false;
+		bool implicit = false;
+		bool pbd = false;
 
 		for (int i = 2; i < argc; ++i) {
 			if (strcmp(argv[i], "-h") == 0 or strcmp(argv[i], "--help") == 0) {
@@ -106,6 +113,15 @@ namespace study_cases {
 				else if (solv_name == "verlet") {
 					solv = solver_type::Verlet;
 				}
+				else if (solv_name == "velocity-verlet") {
+					solv = solver_type::VelocityVerlet;
+				}
+				else if (solv_name == "leapfrog") {
+					solv = solver_type::Leapfrog;
+				}
+				else if (solv_name == "rk4") {
+					solv = solver_type::RK4;
+				}
 				else {
 					cerr << "Error: invalid value for solver." << endl;
 					return;
@@ -121,6 +137,12 @@ namespace study_cases {
 			else if (strcmp(argv[i], "--stretch") == 0) {
 				stretch = true;
 			}
+			else if (strcmp(argv[i], "--implicit") == 0) {
+				implicit = true;
+			}
+			else if (strcmp(argv[i], "--pbd") == 0) {
+				pbd = true;
+			}
 			else {
 				cerr << "Error: unknown option '" << string(argv[i]) << "'" << endl;
 				return;
@@ -142,9 +164,20 @@ namespace study_cases {
 		else if (solv == solver_type::Verlet) {
 			cout << " Verlet" << endl;
 		}
+		else if (solv == solver_type::VelocityVerlet) {
+			cout << " Velocity Verlet" << endl;
+		}
+		else if (solv == solver_type::Leapfrog) {
+			cout << " Leapfrog" << endl;
+		}
+		else if (solv == solver_type::RK4) {
+			cout << " Runge-Kutta 4" << endl;
+		}
 		cout << "    bending? " << (bend ? "Yes" : "No") << endl;
 		cout << "    shear? " << (shear ? "Yes" : "No") << endl;
 		cout << "    stretch? " << (stretch ? "Yes" : "No") << endl;
+		cout << "    implicit? " << (implicit ? "Yes" : "No") << endl;
+		cout << "    position-based? " << (pbd ? "Yes" : "No") << endl;
 
 		const float length = 10.0f;
 		const float height = 10.0f;
@@ -156,6 +189,8 @@ namespace study_cases {
 		M->simulate_bend(bend);
 		M->simulate_shear(shear);
 		M->simulate_stretch(stretch);
+		M->set_implicit(implicit);
+		M->set_position_based(pbd);
 
 		M->allocate(n*m, 5.0f);
 		M->set_dimensions(n, m);
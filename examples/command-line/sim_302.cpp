@@ -56,6 +56,9 @@ void sim_302_usage() {
 	cout << "        euler:      Euler integration method.." << endl;
 	cout << "        semi-euler: Euler semi-implicit integration method." << endl;
 	cout << "        verlet:     Verlet integration method." << endl;
+	cout << "        velocity-verlet: velocity Verlet integration method." << endl;
+	cout << "        leapfrog:   leapfrog (drift-kick-drift) integration method." << endl;
+	cout << "        rk4:        fourth order Runge-Kutta integration method." << endl;
 	cout << "    --R r:          Size of the neighbourhood.     Default: 0.015" << endl;
 	cout << "    --vol v:        Volume of the fluid.           Default: 0.01" << endl;
 	cout << "    --vis v:        Viscosity of the fluid.        Default: 0.001" << endl;
@@ -155,6 +158,15 @@ void sim_302(int argc, char *argv[]) {
 			else if (solv_name == "verlet") {
 				solv = solver_type::Verlet;
 			}
+			else if (solv_name == "velocity-verlet") {
+				solv = solver_type::VelocityVerlet;
+			}
+			else if (solv_name == "leapfrog") {
+				solv = solver_type::Leapfrog;
+			}
+			else if (solv_name == "rk4") {
+				solv = solver_type::RK4;
+			}
 			else {
 				cerr << "Error: invalid value for solver." << endl;
 				return;
@@ -220,6 +232,15 @@ void sim_302(int argc, char *argv[]) {
 	else if (solv == solver_type::Verlet) {
 		cout << " Verlet" << endl;
 	}
+	else if (solv == solver_type::VelocityVerlet) {
+		cout << " Velocity Verlet" << endl;
+	}
+	else if (solv == solver_type::Leapfrog) {
+		cout << " Leapfrog" << endl;
+	}
+	else if (solv == solver_type::RK4) {
+		cout << " Runge-Kutta 4" << endl;
+	}
 
 	kernel_scalar_function W;
 	kernel_functions::density_poly6(h, W);
@@ -28,5 +28,43 @@ field::field() { }
 field::field(const field& ) { }
 field::~field() { }
 
+// MODIFIERS
+
+void field::update(const particles::free_particle *, size_t , size_t ) { }
+
+// OTHERS
+
+void field::compute_forces
+(const particles::free_particle *ps, size_t n, math::vec3 *F)
+{
+	for (size_t i = 0; i < n; ++i) {
+		compute_force(ps[i], F[i]);
+	}
+}
+
+void field::compute_forces
+(const particles::mesh_particle *ps, size_t n, math::vec3 *F)
+{
+	for (size_t i = 0; i < n; ++i) {
+		compute_force(ps[i], F[i]);
+	}
+}
+
+void field::compute_forces
+(const particles::fluid_particle *ps, size_t n, math::vec3 *F)
+{
+	for (size_t i = 0; i < n; ++i) {
+		compute_force(ps[i], F[i]);
+	}
+}
+
+void field::compute_forces
+(const particles::sized_particle *ps, size_t n, math::vec3 *F)
+{
+	for (size_t i = 0; i < n; ++i) {
+		compute_force(ps[i], F[i]);
+	}
+}
+
 } // -- namespace fields
 } // -- namespace physim
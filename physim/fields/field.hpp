@@ -21,8 +21,12 @@
 
 #pragma once
 
+// C includes
+#include <stddef.h>
+
 // physim includes
 #include <physim/particles/free_particle.hpp>
+#include <physim/particles/sized_particle.hpp>
 #include <physim/particles/mesh_particle.hpp>
 #include <physim/particles/fluid_particle.hpp>
 #include <physim/math/vec3.hpp>
@@ -54,6 +58,23 @@ class field {
 		/// Destructor.
 		virtual ~field();
 
+		// MODIFIERS
+
+		/**
+		 * @brief Updates the state of the field at the beginning of
+		 * a time step.
+		 *
+		 * Called by the simulator before moving any particle. Fields
+		 * whose sources are the free particles of the simulation (see
+		 * @ref gravitational_nbody) rebuild their state here. By default,
+		 * this function does nothing.
+		 * @param ps The free particles of the simulation.
+		 * @param n Number of particles.
+		 * @param nt Number of threads.
+		 */
+		virtual void update
+		(const particles::free_particle *ps, size_t n, size_t nt);
+
 		// OTHERS
 
 		/**
@@ -86,6 +107,53 @@ class field {
 		 * particle.
 		 */
 		virtual void compute_force(const particles::fluid_particle& p, math::vec3& F) = 0;
+
+		/**
+		 * @brief Compute the force vectors acting on a block of particles.
+		 *
+		 * The force acting on particle @e ps[i] is stored in @e F[i], for
+		 * every @e i in [0,@e n). By default, this function calls
+		 * @ref compute_force(const particles::free_particle&, math::vec3&)
+		 * on every particle. Fields are expected to override it so that
+		 * the particles are processed in a single loop.
+		 * @param[in] ps Contiguous particles.
+		 * @param[in] n Number of particles.
+		 * @param[out] F The forces from this field acting on the particles.
+		 */
+		virtual void compute_forces
+		(const particles::free_particle *ps, size_t n, math::vec3 *F);
+		/**
+		 * @brief Compute the force vectors acting on a block of particles.
+		 *
+		 * See @ref compute_forces(const particles::free_particle*, size_t, math::vec3*).
+		 * @param[in] ps Contiguous particles.
+		 * @param[in] n Number of particles.
+		 * @param[out] F The forces from this field acting on the particles.
+		 */
+		virtual void compute_forces
+		(const particles::mesh_particle *ps, size_t n, math::vec3 *F);
+		/**
+		 * @brief Compute the force vectors acting on a block of particles.
+		 *
+		 * See @ref compute_forces(const particles::free_particle*, size_t, math::vec3*).
+		 * @param[in] ps Contiguous particles.
+		 * @param[in] n Number of particles.
+		 * @param[out] F The forces from this field acting on the particles.
+		 */
+		virtual void compute_forces
+		(const particles::fluid_particle *ps, size_t n, math::vec3 *F);
+		/**
+		 * @brief Compute the force vectors acting on a block of particles.
+		 *
+		 * See @ref compute_forces(const particles::free_particle*, size_t, math::vec3*).
+		 * A block of sized particles can not be passed as a block of
+		 * free particles, since their sizes differ.
+		 * @param[in] ps Contiguous particles.
+		 * @param[in] n Number of particles.
+		 * @param[out] F The forces from this field acting on the particles.
+		 */
+		virtual void compute_forces
+		(const particles::sized_particle *ps, size_t n, math::vec3 *F);
 };
 
 } // -- namespace fields
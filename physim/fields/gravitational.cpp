@@ -42,6 +42,19 @@ void gravitational::__compute_force(const P& p, vec3& F) {
 	__pm3_mul_v_s(F, v, p.mass*M);
 }
 
+template<class P>
+void gravitational::__compute_forces(const P *ps, size_t n, vec3 *F) {
+	#pragma omp simd
+	for (size_t i = 0; i < n; ++i) {
+		// unit directional vector
+		vec3 v;
+		__pm3_sub_v_v(v, pos, ps[i].cur_pos);
+		normalise(v, v);
+
+		__pm3_mul_v_s(F[i], v, ps[i].mass*M);
+	}
+}
+
 // PUBLIC
 
 gravitational::gravitational() : punctual() {
@@ -89,5 +102,21 @@ void gravitational::compute_force(const fluid_particle& p, vec3& F) {
 	__compute_force(p, F);
 }
 
+void gravitational::compute_forces(const free_particle *ps, size_t n, vec3 *F) {
+	__compute_forces(ps, n, F);
+}
+
+void gravitational::compute_forces(const mesh_particle *ps, size_t n, vec3 *F) {
+	__compute_forces(ps, n, F);
+}
+
+void gravitational::compute_forces(const fluid_particle *ps, size_t n, vec3 *F) {
+	__compute_forces(ps, n, F);
+}
+
+void gravitational::compute_forces(const sized_particle *ps, size_t n, vec3 *F) {
+	__compute_forces(ps, n, F);
+}
+
 } // -- namespace fields
 } // -- namespace physim
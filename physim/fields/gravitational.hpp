@@ -57,6 +57,15 @@ class gravitational : public punctual {
 		 */
 		template<class P>
 		void __compute_force(const P& p, math::vec3& F);
+		/**
+		 * @brief Function that actually computes the forces of this field
+		 * on a block of particles.
+		 *
+		 * Works for @ref particles::free_particle and
+		 * @ref particles::mesh_particle.
+		 */
+		template<class P>
+		void __compute_forces(const P *ps, size_t n, math::vec3 *F);
 
 	protected:
 		/// Mass of object causing the gravitational field. [Kg]
@@ -87,6 +96,15 @@ class gravitational : public punctual {
 		void compute_force(const particles::free_particle& p, math::vec3& F);
 		void compute_force(const particles::mesh_particle& p, math::vec3& F);
 		void compute_force(const particles::fluid_particle& p, math::vec3& F);
+
+		void compute_forces
+		(const particles::free_particle *ps, size_t n, math::vec3 *F);
+		void compute_forces
+		(const particles::mesh_particle *ps, size_t n, math::vec3 *F);
+		void compute_forces
+		(const particles::fluid_particle *ps, size_t n, math::vec3 *F);
+		void compute_forces
+		(const particles::sized_particle *ps, size_t n, math::vec3 *F);
 };
 
 } // -- namespace fields
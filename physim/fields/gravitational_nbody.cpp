@@ -0,0 +1,267 @@
+/*********************************************************************
+ * Real-time physics simulation project
+ * Copyright (C) 2018-2019 Lluís Alemany Puig
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Contact: Lluís Alemany Puig (lluis.alemany.puig@gmail.com)
+ * 
+ ********************************************************************/
+
+#include <physim/fields/gravitational_nbody.hpp>
+
+// C includes
+#include <assert.h>
+#include <math.h>
+
+// C++ includes
+#include <algorithm>
+using namespace std;
+
+// physim includes
+#include <physim/math/private/math3.hpp>
+
+namespace physim {
+using namespace particles;
+using namespace math;
+
+namespace fields {
+
+// PRIVATE
+
+void gravitational_nbody::__compute_force(const free_particle& p, vec3& F) const {
+	__pm3_assign_s(F, 0.0f);
+
+	// A free particle is one of the bodies: it is not attracted by
+	// itself. Since the particle may be at an intermediate position
+	// of the time step, the cells containing its body are always
+	// opened so that it is not part of any approximation.
+	const bool is_body =
+		p.get_particle_type() == particle_type::free_particle and
+		p.index < positions.size();
+	const vec3& body = (is_body ? positions[p.index] : p.cur_pos);
+
+	const float theta2 = theta*theta;
+	const float eps2 = eps*eps;
+
+	// attraction of a mass 'm' at position 'q'
+	auto attract =
+	[&](const vec3& q, float m) -> void {
+		vec3 r;
+		__pm3_sub_v_v(r, q, p.cur_pos);
+		const float d2 = __pm3_norm2(r) + eps2;
+		const float s = m/(d2*sqrt(d2));
+		__pm3_add_acc_vs(F, r, s);
+	};
+
+	tree.visit_nodes(
+		[&](size_t n, const vec3& vmin, const vec3& vmax) -> bool {
+			const cell& c = cells[n];
+			if (c.mass <= 0.0f) {
+				return false;
+			}
+			if (__pm3_inside_box(p.cur_pos, vmin, vmax) or
+				(is_body and __pm3_inside_box(body, vmin, vmax)))
+			{
+				return true;
+			}
+
+			// largest side of the cell
+			const float s = std::max(vmax.x - vmin.x,
+							std::max(vmax.y - vmin.y, vmax.z - vmin.z));
+			const float d2 = __pm3_dist2(c.com, p.cur_pos);
+			if (s*s < theta2*d2) {
+				// far enough: approximate the cell by its centre of mass
+				attract(c.com, c.mass);
+				return false;
+			}
+			return true;
+		},
+		[&](size_t i) -> void {
+			if (is_body and i == p.index) {
+				return;
+			}
+			attract(positions[i], masses[i]);
+		}
+	);
+
+	__pm3_mul_v_s(F, F, G*p.mass);
+}
+
+// PUBLIC
+
+gravitational_nbody::gravitational_nbody() : field() {
+	G = 6.674e-11f;
+	theta = 0.5f;
+	eps = 0.01f;
+	lod = 8;
+}
+
+gravitational_nbody::gravitational_nbody(float _theta, float _eps)
+	: field()
+{
+	G = 6.674e-11f;
+	theta = _theta;
+	eps = _eps;
+	lod = 8;
+}
+
+gravitational_nbody::gravitational_nbody(const gravitational_nbody& f)
+	: field(f)
+{
+	G = f.G;
+	theta = f.theta;
+	eps = f.eps;
+	lod = f.lod;
+}
+
+gravitational_nbody::~gravitational_nbody() {
+}
+
+// MODIFIERS
+
+void gravitational_nbody::update(const free_particle *ps, size_t n, size_t nt) {
+	if (n == 0) {
+		tree.clear();
+		cells.clear();
+		positions.clear();
+		masses.clear();
+		return;
+	}
+
+	// partition the bodies
+	tree.update(&ps[0].cur_pos, n, sizeof(free_particle), lod, nt);
+
+	positions.resize(n);
+	masses.resize(n);
+	#pragma omp parallel for num_threads(nt) if(nt > 1)
+	for (size_t i = 0; i < n; ++i) {
+		__pm3_assign_v(positions[i], ps[i].cur_pos);
+
+		// particles that are not simulated do not attract
+		const bool simulated =
+			not ps[i].fixed and ps[i].starttime <= 0.0f and
+			ps[i].lifetime > 0.0f;
+		masses[i] = (simulated ? ps[i].mass : 0.0f);
+	}
+
+	// Total mass of every cell, and centre of mass.
+	// The weighted sum of the positions is accumulated
+	// in 'com' and divided by the mass at the end.
+	cells.resize(tree.get_num_nodes());
+	for (cell& c : cells) {
+		__pm3_assign_s(c.com, 0.0f);
+		c.mass = 0.0f;
+	}
+
+	tree.visit_nodes_bottom_up(
+		[&](size_t c, size_t i) -> void {
+			__pm3_add_acc_vs(cells[c].com, positions[i], masses[i]);
+			cells[c].mass += masses[i];
+		},
+		[&](size_t c, size_t h) -> void {
+			__pm3_add_acc_v(cells[c].com, cells[h].com);
+			cells[c].mass += cells[h].mass;
+		}
+	);
+
+	for (cell& c : cells) {
+		if (c.mass > 0.0f) {
+			__pm3_div_v_s(c.com, c.com, c.mass);
+		}
+	}
+}
+
+// SETTERS
+
+void gravitational_nbody::set_gravitational_constant(float _G) {
+	G = _G;
+}
+
+void gravitational_nbody::set_opening_angle(float _theta) {
+	assert(_theta >= 0.0f);
+	theta = _theta;
+}
+
+void gravitational_nbody::set_softening(float _eps) {
+	eps = _eps;
+}
+
+void gravitational_nbody::set_lod(size_t _lod) {
+	assert(_lod > 0);
+	lod = _lod;
+}
+
+// GETTERS
+
+float gravitational_nbody::get_gravitational_constant() const {
+	return G;
+}
+
+float gravitational_nbody::get_opening_angle() const {
+	return theta;
+}
+
+float gravitational_nbody::get_softening() const {
+	return eps;
+}
+
+size_t gravitational_nbody::get_lod() const {
+	return lod;
+}
+
+size_t gravitational_nbody::get_num_bodies() const {
+	return positions.size();
+}
+
+// OTHERS
+
+void gravitational_nbody::compute_force(const free_particle& p, vec3& F) {
+	__compute_force(p, F);
+}
+
+void gravitational_nbody::compute_force(const mesh_particle& , vec3& F) {
+	__pm3_assign_s(F, 0.0f);
+}
+
+void gravitational_nbody::compute_force(const fluid_particle& , vec3& F) {
+	__pm3_assign_s(F, 0.0f);
+}
+
+void gravitational_nbody::compute_forces(const free_particle *ps, size_t n, vec3 *F) {
+	for (size_t i = 0; i < n; ++i) {
+		__compute_force(ps[i], F[i]);
+	}
+}
+
+void gravitational_nbody::compute_forces(const mesh_particle *, size_t n, vec3 *F) {
+	for (size_t i = 0; i < n; ++i) {
+		__pm3_assign_s(F[i], 0.0f);
+	}
+}
+
+void gravitational_nbody::compute_forces(const fluid_particle *, size_t n, vec3 *F) {
+	for (size_t i = 0; i < n; ++i) {
+		__pm3_assign_s(F[i], 0.0f);
+	}
+}
+
+void gravitational_nbody::compute_forces(const sized_particle *ps, size_t n, vec3 *F) {
+	for (size_t i = 0; i < n; ++i) {
+		__compute_force(ps[i], F[i]);
+	}
+}
+
+} // -- namespace fields
+} // -- namespace physim
@@ -0,0 +1,200 @@
+/*********************************************************************
+ * Real-time physics simulation project
+ * Copyright (C) 2018-2019 Lluís Alemany Puig
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Contact: Lluís Alemany Puig (lluis.alemany.puig@gmail.com)
+ * 
+ ********************************************************************/
+
+#pragma once
+
+// C includes
+#include <stddef.h>
+
+// C++ includes
+#include <vector>
+
+// physim includes
+#include <physim/particles/free_particle.hpp>
+#include <physim/particles/mesh_particle.hpp>
+#include <physim/particles/fluid_particle.hpp>
+#include <physim/structures/octree.hpp>
+#include <physim/fields/field.hpp>
+#include <physim/math/vec3.hpp>
+
+namespace physim {
+namespace fields {
+
+/**
+ * @brief Gravitational field of a set of bodies.
+ *
+ * The field caused by the free particles of the simulation: every
+ * free particle attracts every other free particle (N-body problem).
+ * The force on a particle of mass \f$m\f$ at position \f$p\f$ is
+ * \f$G \cdot m \cdot \sum_j m_j \cdot \frac{p_j - p}{(||p_j - p||^2 + \epsilon^2)^{3/2}}\f$
+ * where
+ * - \f$G\f$ is the gravitational constant (see @ref G).
+ * - \f$m_j\f$ and \f$p_j\f$ are the mass and position of the j-th body.
+ * - \f$\epsilon\f$ is the softening length (see @ref eps), which keeps
+ * the force bounded when two bodies are very close.
+ *
+ * The sum is approximated with the Barnes-Hut algorithm: the bodies
+ * are partitioned with an octree (see @ref tree), and every cell
+ * stores the total mass and the centre of mass of the bodies in it.
+ * A cell of side @e s at distance @e d of the particle is replaced by
+ * a single body at its centre of mass when \f$s/d < \theta\f$ (see
+ * @ref theta). Therefore, the cost of evaluating the force is
+ * logarithmic in the number of bodies. With \f$\theta = 0\f$ the sum
+ * is computed exactly.
+ *
+ * The bodies are the free particles at the beginning of every time
+ * step (see @ref update). Fixed particles, particles that have not
+ * started moving yet and dead particles have no mass in the field,
+ * since they are not being simulated. A free particle does not
+ * attract itself. Mesh and fluid particles are not affected by this
+ * field.
+ *
+ * The field is evaluated on the free particles in parallel when the
+ * simulator uses several threads, except when collisions between
+ * particles are activated and there are sized or agent particles in
+ * the simulation: then the free particles are simulated one at a
+ * time (see @ref physim::simulator::simulate_free_particles(size_t)),
+ * and so is the evaluation of this field.
+ */
+class gravitational_nbody : public field {
+	private:
+		/// Total mass and centre of mass of the bodies in a cell.
+		struct cell {
+			/// Centre of mass.
+			math::vec3 com;
+			/// Total mass.
+			float mass;
+		};
+
+	private:
+		/**
+		 * @brief Function that actually computes the force of this field.
+		 *
+		 * Traverses the octree of the bodies from the root (see
+		 * @ref fields::gravitational_nbody).
+		 */
+		void __compute_force(const particles::free_particle& p, math::vec3& F) const;
+
+	protected:
+		/// Gravitational constant. [N*m^2/Kg^2]
+		float G;
+		/// Opening angle of the Barnes-Hut approximation.
+		float theta;
+		/// Softening length. [m]
+		float eps;
+		/// Level Of Detail of the octree: bodies per cell.
+		size_t lod;
+
+		/// Partition of the bodies.
+		structures::octree tree;
+		/// Total mass and centre of mass of every node of @ref tree.
+		std::vector<cell> cells;
+		/// Positions of the bodies.
+		std::vector<math::vec3> positions;
+		/// Masses of the bodies.
+		std::vector<float> masses;
+
+	public:
+		/// Default constructor.
+		gravitational_nbody();
+		/// Constructor with opening angle and softening length.
+		gravitational_nbody(float theta, float eps);
+		/// Copy constructor.
+		gravitational_nbody(const gravitational_nbody& f);
+		/// Destructor.
+		virtual ~gravitational_nbody();
+
+		// MODIFIERS
+
+		/**
+		 * @brief Updates the bodies causing the field.
+		 *
+		 * Partitions the particles with @ref tree and computes the
+		 * total mass and centre of mass of every cell. The particles
+		 * that are fixed, have not started moving or are dead are
+		 * given no mass.
+		 * @param ps The free particles of the simulation.
+		 * @param n Number of particles.
+		 * @param nt Number of threads.
+		 */
+		void update(const particles::free_particle *ps, size_t n, size_t nt);
+
+		// SETTERS
+
+		/**
+		 * @brief Sets the gravitational constant. See @ref G.
+		 *
+		 * Default value: 6.674e-11.
+		 */
+		void set_gravitational_constant(float G);
+		/**
+		 * @brief Sets the opening angle. See @ref theta.
+		 *
+		 * Larger values make the evaluation of the field faster but
+		 * less accurate. Default value: 0.5.
+		 */
+		void set_opening_angle(float theta);
+		/**
+		 * @brief Sets the softening length. See @ref eps.
+		 *
+		 * Default value: 0.01.
+		 */
+		void set_softening(float eps);
+		/**
+		 * @brief Sets the number of bodies per cell of the octree.
+		 * See @ref lod.
+		 *
+		 * Default value: 8.
+		 */
+		void set_lod(size_t lod);
+
+		// GETTERS
+
+		/// Returns the gravitational constant. See @ref G.
+		float get_gravitational_constant() const;
+		/// Returns the opening angle. See @ref theta.
+		float get_opening_angle() const;
+		/// Returns the softening length. See @ref eps.
+		float get_softening() const;
+		/// Returns the number of bodies per cell of the octree. See @ref lod.
+		size_t get_lod() const;
+
+		/// Returns the number of bodies causing this field.
+		size_t get_num_bodies() const;
+
+		// OTHERS
+
+		void compute_force(const particles::free_particle& p, math::vec3& F);
+		void compute_force(const particles::mesh_particle& p, math::vec3& F);
+		void compute_force(const particles::fluid_particle& p, math::vec3& F);
+
+		void compute_forces
+		(const particles::free_particle *ps, size_t n, math::vec3 *F);
+		void compute_forces
+		(const particles::mesh_particle *ps, size_t n, math::vec3 *F);
+		void compute_forces
+		(const particles::fluid_particle *ps, size_t n, math::vec3 *F);
+		void compute_forces
+		(const particles::sized_particle *ps, size_t n, math::vec3 *F);
+};
+
+} // -- namespace fields
+} // -- namespace physim
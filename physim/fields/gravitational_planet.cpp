@@ -37,6 +37,15 @@ void gravitational_planet::__compute_force(const P& p, vec3& F) {
 	__pm3_mul_v_s(F, pos, p.mass);
 }
 
+template<class P>
+void gravitational_planet::__compute_forces(const P *ps, size_t n, vec3 *F) {
+	// the same vector scaled by the mass of every particle
+	#pragma omp simd
+	for (size_t i = 0; i < n; ++i) {
+		__pm3_mul_v_s(F[i], pos, ps[i].mass);
+	}
+}
+
 // PUBLIC
 
 gravitational_planet::gravitational_planet() : punctual() {
@@ -69,5 +78,21 @@ void gravitational_planet::compute_force(const fluid_particle& p, vec3& F) {
 	__compute_force(p, F);
 }
 
+void gravitational_planet::compute_forces(const free_particle *ps, size_t n, vec3 *F) {
+	__compute_forces(ps, n, F);
+}
+
+void gravitational_planet::compute_forces(const mesh_particle *ps, size_t n, vec3 *F) {
+	__compute_forces(ps, n, F);
+}
+
+void gravitational_planet::compute_forces(const fluid_particle *ps, size_t n, vec3 *F) {
+	__compute_forces(ps, n, F);
+}
+
+void gravitational_planet::compute_forces(const sized_particle *ps, size_t n, vec3 *F) {
+	__compute_forces(ps, n, F);
+}
+
 } // -- namespace fields
 } // -- namespace physim
@@ -39,6 +39,16 @@ void magnetic_B::__compute_force(const P& p, vec3& F) {
 	__pm3_cross(F, temp, B);
 }
 
+template<class P>
+void magnetic_B::__compute_forces(const P *ps, size_t n, vec3 *F) {
+	#pragma omp simd
+	for (size_t i = 0; i < n; ++i) {
+		vec3 temp;
+		__pm3_mul_v_s(temp, ps[i].cur_vel, ps[i].charge);
+		__pm3_cross(F[i], temp, B);
+	}
+}
+
 // PUBLIC
 
 magnetic_B::magnetic_B() : magnetic() { }
@@ -69,8 +79,28 @@ void magnetic_B::compute_force(const mesh_particle& p, vec3& F) {
 	__compute_force(p, F);
 }
 
-void magnetic_B::compute_force(const fluid_particle&, vec3&) {
-	// do nothing
+void magnetic_B::compute_force(const fluid_particle&, vec3& F) {
+	// fluid particles have no charge
+	__pm3_assign_s(F, 0.0f);
+}
+
+void magnetic_B::compute_forces(const free_particle *ps, size_t n, vec3 *F) {
+	__compute_forces(ps, n, F);
+}
+
+void magnetic_B::compute_forces(const mesh_particle *ps, size_t n, vec3 *F) {
+	__compute_forces(ps, n, F);
+}
+
+void magnetic_B::compute_forces(const fluid_particle *ps, size_t n, vec3 *F) {
+	// fluid particles have no charge
+	for (size_t i = 0; i < n; ++i) {
+		__pm3_assign_s(F[i], 0.0f);
+	}
+}
+
+void magnetic_B::compute_forces(const sized_particle *ps, size_t n, vec3 *F) {
+	__compute_forces(ps, n, F);
 }
 
 } // -- namespace fields
@@ -22,11 +22,15 @@
 #include <physim/fluids/fluid.hpp>
 
 // C includes
+#include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <omp.h>
 
 // C++ includes
+#include <algorithm>
 #include <iostream>
+#include <limits>
 #include <vector>
 using namespace std;
 
@@ -34,6 +38,18 @@ using namespace std;
 #include <physim/math/private/math3.hpp>
 #include <physim/math/vec3.hpp>
 
+// spreads the lowest 21 bits of x so that there
+// are two zeros between every two consecutive bits
+inline uint64_t spread_bits(uint64_t x) {
+	x &= 0x1fffff;
+	x = (x | x << 32) & 0x1f00000000ffff;
+	x = (x | x << 16) & 0x1f0000ff0000ff;
+	x = (x | x << 8) & 0x100f00f00f00f00f;
+	x = (x | x << 4) & 0x10c30c30c30c30c3;
+	x = (x | x << 2) & 0x1249249249249249;
+	return x;
+}
+
 namespace physim {
 using namespace math;
 using namespace particles;
@@ -43,12 +59,50 @@ namespace fluids {
 
 // PROTECTED
 
+void fluid::make_particle_arrays(size_t n) {
+	// these do not allocate memory if the size does not grow
+	pos_x.resize(N);
+	pos_y.resize(N);
+	pos_z.resize(N);
+	vel_x.resize(N);
+	vel_y.resize(N);
+	vel_z.resize(N);
+	masses.resize(N);
+	densities.resize(N);
+	pressures.resize(N);
+
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < N; ++i) {
+		pos_x[i] = ps[i].cur_pos.x;
+		pos_y[i] = ps[i].cur_pos.y;
+		pos_z[i] = ps[i].cur_pos.z;
+		vel_x[i] = ps[i].cur_vel.x;
+		vel_y[i] = ps[i].cur_vel.y;
+		vel_z[i] = ps[i].cur_vel.z;
+		masses[i] = ps[i].mass;
+	}
+}
+
+void fluid::periodic_sort(size_t n) {
+	if (sort_period == 0) {
+		return;
+	}
+	if (sort_count == 0) {
+		sort_particles(n);
+	}
+	sort_count = (sort_count + 1)%sort_period;
+}
+
 // PUBLIC
 
 fluid::fluid() {
 	N = 0;
 	ps = nullptr;
+	search = neighbour_search::hash_grid;
 	tree = nullptr;
+	grid = nullptr;
+	sort_period = 0;
+	sort_count = 0;
 
 	// use empty kernels, to avoid segmentation
 	// faults and things like these
@@ -64,6 +118,10 @@ fluid::~fluid() {
 		delete tree;
 		tree = nullptr;
 	}
+	if (grid != nullptr) {
+		delete grid;
+		grid = nullptr;
+	}
 }
 
 // OPERATORS
@@ -83,6 +141,9 @@ void fluid::allocate
 	if (tree == nullptr) {
 		tree = new octree();
 	}
+	if (grid == nullptr) {
+		grid = new hash_grid();
+	}
 
 	speed_sound = cs;
 	R = r;
@@ -118,6 +179,12 @@ void fluid::allocate
 		ps[i].index = i;
 		ps[i].mass = mass_per_particle;
 	}
+
+	positions.resize(N);
+	for (size_t i = 0; i < N; ++i) {
+		positions[i] = i;
+	}
+	sort_count = 0;
 }
 
 void fluid::clear() {
@@ -125,12 +192,93 @@ void fluid::clear() {
 		free(ps);
 		ps = nullptr;
 	}
+
+	pos_x.clear();
+	pos_y.clear();
+	pos_z.clear();
+	vel_x.clear();
+	vel_y.clear();
+	vel_z.clear();
+	masses.clear();
+	densities.clear();
+	pressures.clear();
+
+	neighs_begin.clear();
+	neighs.clear();
+	neighs_d2.clear();
+
+	positions.clear();
+}
+
+void fluid::make_partition(size_t n) {
+	switch (search) {
+	case neighbour_search::octree:
+		// the octree is built again only when the
+		// particles moved too much since the last call
+		tree->update(&ps[0].cur_pos.x, N, sizeof(fluid_particle), 8, n);
+		break;
+	case neighbour_search::hash_grid:
+		// the grid keeps its memory between calls
+		grid->init(&ps[0].cur_pos.x, N, sizeof(fluid_particle), R);
+		break;
+	default:
+		;
+	}
 }
 
-void fluid::make_partition() {
-	tree->clear();
+void fluid::sort_particles(size_t n) {
+	if (N == 0) {
+		return;
+	}
+
+	// origin of the grid: minimum coordinates of the particles
+	static const float inf = numeric_limits<float>::max();
+	vec3 origin;
+	__pm3_assign_s(origin, inf);
+	for (size_t i = 0; i < N; ++i) {
+		__pm3_min2(origin, origin, ps[i].cur_pos);
+	}
 
-	tree->init(&ps[0].cur_pos.x, N, sizeof(fluid_particle));
+	const float inv_cell_size = (R > 0.0f ? 1.0f/R : 1.0f);
+
+	// cell coordinates, using 21 bits per axis
+	auto cell =
+	[&](float c, float o) -> uint64_t {
+		const float k = (c - o)*inv_cell_size;
+		return (k < float(0x1fffff) ? static_cast<uint64_t>(k) : 0x1fffff);
+	};
+
+	// Morton code of the cell of every particle
+	vector<uint64_t> keys(N);
+	vector<size_t> order(N);
+
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < N; ++i) {
+		keys[i] =
+			 spread_bits(cell(ps[i].cur_pos.x, origin.x)) |
+			(spread_bits(cell(ps[i].cur_pos.y, origin.y)) << 1) |
+			(spread_bits(cell(ps[i].cur_pos.z, origin.z)) << 2);
+		order[i] = i;
+	}
+
+	// particles in the same cell keep their relative order
+	std::sort(
+		order.begin(), order.end(),
+		[&](size_t i, size_t j) -> bool {
+			return keys[i] < keys[j] or (keys[i] == keys[j] and i < j);
+		}
+	);
+
+	// move the particles
+	vector<fluid_particle> copy(ps, ps + N);
+
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t k = 0; k < N; ++k) {
+		ps[k] = copy[order[k]];
+
+		assert(ps[k].index < N);
+		positions[ps[k].index] = k;
+	}
 }
 
 // SETTERS
@@ -147,6 +295,15 @@ void fluid::set_kernel_viscosity(const kernel_scalar_function& W_v) {
 	kernel_viscosity = W_v;
 }
 
+void fluid::set_neighbour_search(const neighbour_search& s) {
+	search = s;
+}
+
+void fluid::set_sort_period(size_t p) {
+	sort_period = p;
+	sort_count = 0;
+}
+
 // GETTERS
 
 size_t fluid::size() const {
@@ -165,6 +322,26 @@ float fluid::get_viscosity() const {
 	return viscosity;
 }
 
+float fluid::get_speed_sound() const {
+	return speed_sound;
+}
+
+float fluid::get_neighbourhood_size() const {
+	return R;
+}
+
+neighbour_search fluid::get_neighbour_search() const {
+	return search;
+}
+
+size_t fluid::get_sort_period() const {
+	return sort_period;
+}
+
+size_t fluid::get_position(size_t i) const {
+	return positions[i];
+}
+
 fluid_particle *fluid::get_particles() {
 	return ps;
 }
@@ -24,14 +24,50 @@
 // C includes
 #include <stddef.h>
 
+// C++ includes
+#include <cstdint>
+#include <vector>
+
 // physim includes
 #include <physim/particles/fluid_particle.hpp>
 #include <physim/fluids/kernel_function.hpp>
+#include <physim/structures/hash_grid.hpp>
 #include <physim/structures/octree.hpp>
 
 namespace physim {
 namespace fluids {
 
+/**
+ * @brief The different neighbour search algorithms.
+ *
+ * Each algorithm finds, for every particle of a fluid, the particles
+ * at distance at most the neighbourhood size (see @ref fluid::R):
+ * - exhaustive: see @ref neighbour_search::exhaustive.
+ * - octree: see @ref neighbour_search::octree.
+ * - hash_grid: see @ref neighbour_search::hash_grid.
+ */
+enum class neighbour_search : int8_t {
+	/**
+	 * Every pair of particles is tested. This takes quadratic time
+	 * on the number of particles and is meant for testing purposes.
+	 */
+	exhaustive,
+
+	/**
+	 * The particles are partitioned with an octree (see
+	 * @ref structures::octree) that is updated at every time step.
+	 */
+	octree,
+
+	/**
+	 * The particles are sorted into a hashed uniform grid whose
+	 * cells have side length equal to the neighbourhood size (see
+	 * @ref structures::hash_grid). Each particle's neighbours are
+	 * looked for in the 27 cells surrounding it.
+	 */
+	hash_grid
+};
+
 /**
  * @brief Class implementing a fluid.
  *
@@ -39,6 +75,12 @@ namespace fluids {
  *
  * It is also characterised by a kernel function and its gradients (see
  * @ref kernel_density, @ref kernel_pressure, @ref kernel_viscosity).
+ *
+ * The particles can be sorted periodically so that particles close in
+ * space are also close in memory (see @ref sort_period). Then, the
+ * position of a particle in the array of particles changes, but its
+ * index (see @ref particles::base_particle::index) does not. The
+ * position of each particle can be retrieved with @ref get_position.
  */
 class fluid {
 	protected:
@@ -141,12 +183,128 @@ class fluid {
 		 */
 		kernel_scalar_function kernel_viscosity;
 
+		/**
+		 * @brief Algorithm used to find the neighbours of the particles.
+		 *
+		 * Default: @ref neighbour_search::hash_grid.
+		 */
+		neighbour_search search;
+
 		/**
 		 * @brief Space partition of this fluid's particles.
 		 *
-		 * Used for fast neighbourhood queries.
+		 * Used for fast neighbourhood queries when @ref search is
+		 * @ref neighbour_search::octree.
 		 */
 		structures::octree *tree;
+		/**
+		 * @brief Uniform grid of this fluid's particles.
+		 *
+		 * Used for fast neighbourhood queries when @ref search is
+		 * @ref neighbour_search::hash_grid.
+		 */
+		structures::hash_grid *grid;
+
+		/**
+		 * @brief Number of calls to @ref update_forces between two
+		 * sorts of the particles.
+		 *
+		 * The particles are sorted at the first call to @ref update_forces
+		 * and then every @ref sort_period calls (see @ref sort_particles).
+		 * If 0, the particles are never sorted automatically.
+		 *
+		 * Default: 0.
+		 */
+		size_t sort_period;
+		/// Number of calls to @ref update_forces since the last sort.
+		size_t sort_count;
+		/**
+		 * @brief Position of every particle.
+		 *
+		 * The @e i-th position contains the position in @ref ps of the
+		 * particle with index @e i.
+		 */
+		std::vector<size_t> positions;
+
+		/**
+		 * @brief Structure-of-arrays copy of the particles' state.
+		 *
+		 * The @e i-th position of each of these arrays holds one attribute
+		 * of the @e i-th particle in @ref ps: the components of its position
+		 * (@ref pos_x, @ref pos_y, @ref pos_z) and velocity (@ref vel_x,
+		 * @ref vel_y, @ref vel_z), its mass (@ref masses), its density
+		 * (@ref densities) and its pressure (@ref pressures).
+		 *
+		 * Only the attributes that are read from neighbouring particles
+		 * are copied, so that the density and force computations traverse
+		 * contiguous memory. The particles in @ref ps remain the actual
+		 * state of the fluid: the positions, velocities and masses are
+		 * copied at every time step (see @ref make_particle_arrays) and the
+		 * densities and pressures are written to both layouts.
+		 *
+		 * These arrays are kept between time steps so that their memory
+		 * is reused.
+		 */
+		std::vector<float> pos_x;
+		/// See @ref pos_x.
+		std::vector<float> pos_y;
+		/// See @ref pos_x.
+		std::vector<float> pos_z;
+		/// See @ref pos_x.
+		std::vector<float> vel_x;
+		/// See @ref pos_x.
+		std::vector<float> vel_y;
+		/// See @ref pos_x.
+		std::vector<float> vel_z;
+		/// See @ref pos_x.
+		std::vector<float> masses;
+		/// See @ref pos_x.
+		std::vector<float> densities;
+		/// See @ref pos_x.
+		std::vector<float> pressures;
+
+		/**
+		 * @brief Neighbour lists of the particles.
+		 *
+		 * The neighbour lists are stored in compressed sparse row
+		 * format: the indices of the neighbours of the @e i-th particle
+		 * are those in the interval [neighs_begin[i], neighs_begin[i + 1])
+		 * of @ref neighs. This vector has @ref N + 1 elements.
+		 *
+		 * These lists are kept between time steps so that their
+		 * memory is reused.
+		 */
+		std::vector<size_t> neighs_begin;
+		/// Indices of the neighbours of every particle (see @ref neighs_begin).
+		std::vector<size_t> neighs;
+		/**
+		 * @brief Squared distances to the neighbours of every particle.
+		 *
+		 * The value at position @e k is the squared distance between
+		 * the particle and its neighbour at position @e k in @ref neighs.
+		 */
+		std::vector<float> neighs_d2;
+
+	protected:
+
+		/**
+		 * @brief Copies the state of the particles into the arrays.
+		 *
+		 * Copies the position, velocity and mass of every particle
+		 * in @ref ps into @ref pos_x, @ref pos_y, ... (see @ref pos_x).
+		 * @param n Number of threads.
+		 */
+		void make_particle_arrays(size_t n);
+
+		/**
+		 * @brief Sorts the particles if it is time to.
+		 *
+		 * Calls @ref sort_particles if @ref sort_period calls were
+		 * made since the last sort. Called at every call to
+		 * @ref update_forces.
+		 * @param n Number of threads.
+		 */
+		void periodic_sort(size_t n);
 
 	public:
 		/// Default onstructor.
@@ -225,10 +383,28 @@ class fluid {
 		/**
 		 * @brief Builds the space partition of this fluid's particles.
 		 *
-		 * Constructs the partition using @ref tree. The contents of the
-		 * tree are first cleared and then rebuilt again.
+		 * Constructs the partition used by the neighbour search
+		 * algorithm (see @ref search): @ref tree or @ref grid. The
+		 * grid is rebuilt, and the octree is updated with the new
+		 * positions of the particles (see @ref structures::octree::update).
+		 * Does nothing if the search is exhaustive.
+		 * @param n Number of threads.
+		 */
+		void make_partition(size_t n);
+
+		/**
+		 * @brief Sorts the particles of this fluid in space.
+		 *
+		 * The particles are sorted in Z-order (or Morton order) of the
+		 * cells of a grid with cells of size @ref R, so that particles
+		 * that are close in space tend to be close in the array of
+		 * particles. Particles in the same cell keep their relative order.
+		 *
+		 * The indices of the particles do not change, and their new
+		 * positions are stored in @ref positions.
+		 * @param n Number of threads.
 		 */
-		void make_partition();
+		void sort_particles(size_t n);
 
 		// SETTERS
 
@@ -248,6 +424,18 @@ class fluid {
 		 */
 		void set_kernel_viscosity(const kernel_scalar_function& W_v);
 
+		/**
+		 * @brief Sets the neighbour search algorithm.
+		 * @param s See @ref search.
+		 */
+		void set_neighbour_search(const neighbour_search& s);
+
+		/**
+		 * @brief Sets the period of the sorts of the particles.
+		 * @param p See @ref sort_period.
+		 */
+		void set_sort_period(size_t p);
+
 		// GETTERS
 
 		/// Returns the number of particles.
@@ -258,6 +446,21 @@ class fluid {
 		float get_density() const;
 		/// Returns the viscosity of the fluid.
 		float get_viscosity() const;
+		/// Returns the speed of sound in the fluid (see @ref speed_sound).
+		float get_speed_sound() const;
+		/// Returns the neighbourhood size (see @ref R).
+		float get_neighbourhood_size() const;
+		/// Returns the neighbour search algorithm (see @ref search).
+		neighbour_search get_neighbour_search() const;
+		/// Returns the period of the sorts of the particles (see @ref sort_period).
+		size_t get_sort_period() const;
+		/**
+		 * @brief Returns the position of a particle.
+		 * @param i Index of the particle (see @ref particles::base_particle::index).
+		 * @returns Returns the position in the array of particles of the
+		 * particle with index @e i.
+		 */
+		size_t get_position(size_t i) const;
 
 		/// Returns a reference to this fluid's particles.
 		particles::fluid_particle *get_particles();
@@ -0,0 +1,189 @@
+/*********************************************************************
+ * Real-time physics simulation project
+ * Copyright (C) 2018-2019 Lluís Alemany Puig
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Contact: Lluís Alemany Puig (lluis.alemany.puig@gmail.com)
+ * 
+ ********************************************************************/
+
+#pragma once
+
+// C includes
+#include <math.h>
+
+// physim includes
+#include <physim/math/vec3.hpp>
+
+namespace physim {
+namespace fluids {
+
+/**
+ * @brief Built-in kernel functions.
+ *
+ * Each kernel function is a type whose constructor takes the
+ * neighbourhood size \f$H\f$ and precomputes the constants of the
+ * function. These types can be used as template parameters of
+ * @ref templated_newtonian, so that their evaluation is inlined, but
+ * also as @ref kernel_scalar_function or @ref kernel_vectorial_function
+ * objects.
+ *
+ * Scalar kernels (density and viscosity) implement
+ \verbatim
+ float operator() (float r2) const
+ \endverbatim
+ * where @e r2 is the squared distance between two particles.
+ *
+ * Vectorial kernels (pressure) implement
+ \verbatim
+ float scale(float r2) const
+ \endverbatim
+ * which returns the value @e s such that the kernel evaluated at the
+ * vector @e r between two particles is @e r*s.
+ *
+ * All kernels are meant to be evaluated for squared distances in the
+ * interval \f$[0, H^2]\f$.
+ */
+namespace kernels {
+
+/**
+ * @brief Poly6 density kernel.
+ *
+ * \f$ W(r) = \frac{315}{64\pi} \left(\frac{1}{H} - \frac{r^2}{H^3}\right)^3 \f$
+ */
+struct density_poly6 {
+	/// \f$1/H\f$.
+	float inv_H;
+	/// \f$1/H^3\f$.
+	float inv_H3;
+
+	/// Constructor.
+	density_poly6(float H) {
+		inv_H = 1.0f/H;
+		inv_H3 = 1.0f/(H*H*H);
+	}
+	/// Evaluates the kernel at squared distance @e r2.
+	inline float operator() (float r2) const {
+		const float k = inv_H - r2*inv_H3;
+		return (315.0f/(64.0f*float(M_PI)))*k*k*k;
+	}
+};
+
+/**
+ * @brief Gradient of the poly6 kernel, used for pressure.
+ *
+ * \f$ \nabla W(r) = -\frac{945}{32\pi H^5} \left(1 - \frac{r^2}{H^2}\right)^2 r \f$
+ */
+struct pressure_poly6 {
+	/// \f$1/H^2\f$.
+	float inv_H2;
+	/// \f$-945/(32\pi H^5)\f$.
+	float C;
+
+	/// Constructor.
+	pressure_poly6(float H) {
+		inv_H2 = 1.0f/(H*H);
+		C = -945.0f/(32.0f*float(M_PI)*pow(H, 5.0f));
+	}
+	/// Returns the scale of the vector at squared distance @e r2.
+	inline float scale(float r2) const {
+		const float k = 1.0f - r2*inv_H2;
+		return C*k*k;
+	}
+	/// Evaluates the kernel at vector @e r, at squared distance @e r2.
+	inline void operator() (const math::vec3& r, float r2, math::vec3& res) const {
+		res = r*scale(r2);
+	}
+};
+
+/**
+ * @brief Gradient of the spiky kernel, used for pressure.
+ *
+ * \f$ \nabla W(r) = -\frac{45}{\pi H^6} (H - |r|)^2 \frac{r}{|r|} \f$
+ *
+ * Evaluates to 0 at distance 0.
+ */
+struct pressure_spiky {
+	/// \f$H\f$.
+	float H;
+	/// \f$-45/(\pi H^6)\f$.
+	float C;
+
+	/// Constructor.
+	pressure_spiky(float _H) {
+		H = _H;
+		C = -45.0f/(float(M_PI)*pow(H, 6.0f));
+	}
+	/// Returns the scale of the vector at squared distance @e r2.
+	inline float scale(float r2) const {
+		const float r = sqrtf(r2);
+		const float k = H - r;
+		return (r > 0.0f ? C*k*k/r : 0.0f);
+	}
+	/// Evaluates the kernel at vector @e r, at squared distance @e r2.
+	inline void operator() (const math::vec3& r, float r2, math::vec3& res) const {
+		res = r*scale(r2);
+	}
+};
+
+/**
+ * @brief Laplacian of the poly6 kernel, used for viscosity.
+ *
+ * \f$ \nabla^2 W(r) = \frac{945}{8\pi H^5} k \left(\frac{r^2}{H^2} - \frac{3}{4}k\right) \f$,
+ * where \f$k = 1 - r^2/H^2\f$.
+ */
+struct viscosity_poly6 {
+	/// \f$1/H^2\f$.
+	float inv_H2;
+	/// \f$945/(8\pi H^5)\f$.
+	float C;
+
+	/// Constructor.
+	viscosity_poly6(float H) {
+		inv_H2 = 1.0f/(H*H);
+		C = 945.0f/(8.0f*float(M_PI)*pow(H, 5.0f));
+	}
+	/// Evaluates the kernel at squared distance @e r2.
+	inline float operator() (float r2) const {
+		const float k = 1.0f - r2*inv_H2;
+		return C*k*(r2*inv_H2 - 0.75f*k);
+	}
+};
+
+/**
+ * @brief Laplacian of the viscosity kernel.
+ *
+ * \f$ \nabla^2 W(r) = \frac{45}{\pi H^6} (H - |r|) \f$
+ */
+struct viscosity_spiky {
+	/// \f$H\f$.
+	float H;
+	/// \f$45/(\pi H^6)\f$.
+	float C;
+
+	/// Constructor.
+	viscosity_spiky(float _H) {
+		H = _H;
+		C = 45.0f/(float(M_PI)*pow(H, 6.0f));
+	}
+	/// Evaluates the kernel at squared distance @e r2.
+	inline float operator() (float r2) const {
+		return C*(H - sqrtf(r2));
+	}
+};
+
+} // -- namespace kernels
+} // -- namespace fluids
+} // -- namespace physim
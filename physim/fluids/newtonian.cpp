@@ -35,10 +35,6 @@ using namespace std;
 #include <physim/math/private/numeric.hpp>
 #include <physim/math/vec3.hpp>
 
-// neighbour computation
-#define SAFE_NEIGH			0
-#define EXPL_NEIGH			1
-
 // output intermediate results
 #define OUTPUT_NEIGHBOURS	0
 #define OUTPUT_DENS			0
@@ -51,10 +47,6 @@ using namespace std;
 #define OUTPUT_PRESS_DENS (OUTPUT_DENS + OUTPUT_PRESS)
 #define OUTPUT (OUTPUT_NEIGHBOURS + OUTPUT_DENS + OUTPUT_PRESS + OUTPUT_ACCEL_PRESS + OUTPUT_ACCEL_VISC + OUTPUT_FORCE)
 
-#if (SAFE_NEIGH == 1) && (EXPL_NEIGH == 1)
-#error("Can't use both safe and experimental neighbour retrieval")
-#endif
-
 namespace physim {
 using namespace math;
 using namespace particles;
@@ -64,108 +56,174 @@ namespace fluids {
 
 // PROTECTED
 
-void newtonian::make_neighbours_lists
-(size_t i, vector<size_t>& neighs, vector<float>& d2s)
-const
-{
-	//cout << "    " << i << ":" << endl;
-	for (size_t j = 0; j < N; ++j) {
-		if (i == j) {
-			continue;
+template<class Callback>
+void newtonian::iterate_neighbours(size_t i, Callback f) const {
+	const float xi = pos_x[i];
+	const float yi = pos_y[i];
+	const float zi = pos_z[i];
+
+	// squared distance between the i-th and the j-th particles
+	auto dist2 =
+	[&](size_t j) -> float {
+		return __pm_sq(pos_x[j] - xi) + __pm_sq(pos_y[j] - yi) + __pm_sq(pos_z[j] - zi);
+	};
+
+	switch (search) {
+
+	case neighbour_search::exhaustive:
+		for (size_t j = 0; j < N; ++j) {
+			if (i == j) {
+				continue;
+			}
+			float d2 = dist2(j);
+			if (d2 <= __pm_sq(R)) {
+				f(j, d2);
+			}
 		}
-		float d2 = __pm3_dist2(ps[i].cur_pos, ps[j].cur_pos);
-		if (d2 <= __pm_sq(R)) {
-			neighs.push_back(j);
-			d2s.push_back(d2);
+		break;
+
+	case neighbour_search::octree: {
+		/* the cells visited may contain particles
+		 * farther than R: keep only those close enough */
+		tree->visit_indices(ps[i].cur_pos, R,
+			[&](size_t j) -> bool {
+				if (i != j) {
+					float d2 = dist2(j);
+					if (d2 <= __pm_sq(R)) {
+						f(j, d2);
+					}
+				}
+				return false;
+			}
+		);
+		break;
+	}
+
+	case neighbour_search::hash_grid: {
+		/* the buckets may contain particles farther
+		 * than R: keep only those close enough */
+		size_t buckets[27];
+		size_t nb = grid->get_buckets(ps[i].cur_pos, buckets);
+		for (size_t b = 0; b < nb; ++b) {
+			const size_t *it = grid->begin_bucket(buckets[b]);
+			const size_t *end = grid->end_bucket(buckets[b]);
+			for (; it != end; ++it) {
+				size_t j = *it;
+				if (i == j) {
+					continue;
+				}
+				float d2 = dist2(j);
+				if (d2 <= __pm_sq(R)) {
+					f(j, d2);
+				}
+			}
 		}
+		break;
+	}
+
 	}
 }
 
-void newtonian::make_neighbours_lists_tree
-(size_t i, vector<size_t>& neighs, vector<float>& d2s) const
-{
-	tree->get_indices(ps[i].cur_pos, R, neighs);
-	d2s = vector<float>(neighs.size());
-
-	/* resort by distances: put those farther than R
-	 * at the back of the vector */
-	size_t lim = neighs.size();
-	size_t j_it = 0;
-	while (j_it < lim) {
-		size_t j = neighs[j_it];
-		d2s[j_it] = __pm3_dist2(ps[i].cur_pos, ps[j].cur_pos);
-		if (d2s[j_it] > __pm_sq(R) or j == i) {
-			/* Put this element at the end. (to be removed)
-			 * Do not advance 'j_it' */
-			swap(neighs[j_it], neighs[lim - 1]);
-			swap(d2s[j_it], d2s[lim - 1]);
-			--lim;
-		}
-		else {
-			/* this element is OK. Move forward. */
-			++j_it;
-		}
+void newtonian::make_neighbours_lists(size_t n) {
+	periodic_sort(n);
+	make_particle_arrays(n);
+	make_partition(n);
+
+	// 1. Count the neighbours of every particle. The count
+	// of the i-th particle is stored at position i + 1.
+	neighs_begin.resize(N + 1);
+	neighs_begin[0] = 0;
+
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < N; ++i) {
+		size_t c = 0;
+		iterate_neighbours(i, [&](size_t, float) -> void { ++c; });
+		neighs_begin[i + 1] = c;
+	}
+
+	// 2. Prefix sum: first position of every list.
+	for (size_t i = 1; i <= N; ++i) {
+		neighs_begin[i] += neighs_begin[i - 1];
+	}
+
+	// these do not allocate memory if the size does not grow
+	neighs.resize(neighs_begin[N]);
+	neighs_d2.resize(neighs_begin[N]);
+
+	// 3. Fill the lists.
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < N; ++i) {
+		size_t k = neighs_begin[i];
+		iterate_neighbours(i,
+			[&](size_t j, float d2) -> void {
+				neighs[k] = j;
+				neighs_d2[k] = d2;
+				++k;
+			}
+		);
 	}
-	/* remove last elements */
-	neighs.erase( neighs.begin() + lim, neighs.end() );
-	d2s.erase( d2s.begin() + lim, d2s.end() );
 
 #if OUTPUT_NEIGHBOURS == 1
 	cout << "Neighbours:" << endl;
-	cout << "    particle " << i << " has " << neighs.size() << " neighbours" << endl;
-	cout << "    particle is at: " << __pm3_out(ps[i].cur_pos) << endl;
-	cout << "    neighbours:" << endl;
-	for (size_t j_it = 0; j_it < neighs.size(); ++j_it) {
-		size_t j = neighs[j_it];
-		cout << "        " << j << ": " << __pm3_out(ps[j].cur_pos)
-			 << " .. d2= " << d2s[j_it] << endl;
+	for (size_t i = 0; i < N; ++i) {
+		cout << "    particle " << i << " has "
+			 << neighs_begin[i + 1] - neighs_begin[i] << " neighbours" << endl;
+		cout << "    particle is at: " << __pm3_out(ps[i].cur_pos) << endl;
+		cout << "    neighbours:" << endl;
+		for (size_t j_it = neighs_begin[i]; j_it < neighs_begin[i + 1]; ++j_it) {
+			size_t j = neighs[j_it];
+			cout << "        " << j << ": " << __pm3_out(ps[j].cur_pos)
+				 << " .. d2= " << neighs_d2[j_it] << endl;
+		}
 	}
 #endif
 }
 
-void newtonian::initialise_density_pressure
-(size_t i, const vector<size_t>& neighs, const vector<float>& d2s)
-{
+void newtonian::initialise_density_pressure(size_t i) {
 #if OUTPUT_PRESS_DENS == 1
 	cout << "    ** particle " << i << endl;
 #endif
 
-	ps[i].density = 0.0f;
+	float dens = 0.0f;
 	/* iterate over the list of neighbours.
 	 * initialise density, pressure */
-	for (size_t j_it = 0; j_it < neighs.size(); ++j_it) {
+	for (size_t j_it = neighs_begin[i]; j_it < neighs_begin[i + 1]; ++j_it) {
 		size_t j = neighs[j_it];
-		float d2 = d2s[j_it];
+		float d2 = neighs_d2[j_it];
 
 #if OUTPUT_DENS == 1
 		cout << "        for neighbour " << j << " at distance^2= " << d2 << endl;
-		cout << "            density before= " << ps[i].density << endl;
+		cout << "            density before= " << dens << endl;
 #endif
 
-		ps[i].density += ps[j].mass*kernel_density(d2);
+		dens += masses[j]*kernel_density(d2);
 
 #if OUTPUT_DENS == 1
-		cout << "            density after= " << ps[i].density << endl;
-		cout << "            contribution=   " << ps[j].mass*kernel_density(d2) << endl;
+		cout << "            density after= " << dens << endl;
+		cout << "            contribution=   " << masses[j]*kernel_density(d2) << endl;
 		cout << "                ps[" << j << "].mass= " << ps[j].mass << endl;
 		cout << "                ps[" << j << "].cur_pos= "
 			 << __pm3_out(ps[j].cur_pos) << endl;
-		cout << "                d2s[" << j_it << "]= "
+		cout << "                neighs_d2[" << j_it << "]= "
 			 << d2 << endl;
 		cout << "                W_density()= "
 			 << kernel_density(d2) << endl;
 #endif
 
 	}
-	ps[i].density += ps[i].mass*kernel_density(0.0f);
+	dens += masses[i]*kernel_density(0.0f);
 
 #if OUTPUT_DENS == 1
-	cout << "    final density= " << ps[i].density << endl;
+	cout << "    final density= " << dens << endl;
 	cout << "        self-contribution= "
-		 << ps[i].mass*kernel_density(0.0f) << endl;
+		 << masses[i]*kernel_density(0.0f) << endl;
 #endif
 
-	ps[i].pressure = __pm_sq(speed_sound)*(ps[i].density - density);
+	densities[i] = dens;
+	pressures[i] = __pm_sq(speed_sound)*(dens - density);
+
+	ps[i].density = densities[i];
+	ps[i].pressure = pressures[i];
 
 #if OUTPUT_PRESS == 1
 	cout << "    pressure= " << ps[i].pressure << endl;
@@ -173,11 +231,10 @@ void newtonian::initialise_density_pressure
 #endif
 }
 
-void newtonian::update_force
-(size_t i, const vector<size_t>& neighs, const vector<float>& d2s)
-{
+void newtonian::update_force(size_t i) {
 #if OUTPUT_ACCEL_FORCE > 0
-	cout << "    ** particle " << i << ". # neighbours= " << neighs.size() << endl;
+	cout << "    ** particle " << i << ". # neighbours= "
+		 << neighs_begin[i + 1] - neighs_begin[i] << endl;
 #endif
 
 	/* total acceleration */
@@ -185,19 +242,21 @@ void newtonian::update_force
 	/* auxiliary vectors */
 	vec3 part_i_to_j, pressure_dir, press_acc, visc_acc;
 
+	/* pressure term of the i-th particle */
+	const float press_i = pressures[i]*__pm_inv(__pm_sq(densities[i]));
 
-	for (size_t j_it = 0; j_it < neighs.size(); ++j_it) {
+	for (size_t j_it = neighs_begin[i]; j_it < neighs_begin[i + 1]; ++j_it) {
 		size_t j = neighs[j_it];
-		float d2 = d2s[j_it];
+		float d2 = neighs_d2[j_it];
 
 		/* pressure acceleration */
 		/*  NOTE: the '-' is important for the correctness of the pressure
 			computation. Without the '-' we need to compute 'part_i_to_j'
 			as pos_j - pos_i. */
-		__pm3_sub_v_v(part_i_to_j, ps[i].cur_pos, ps[j].cur_pos);
-		float Pij = -ps[j].mass*(
-			ps[i].pressure*__pm_inv(__pm_sq(ps[i].density)) +
-			ps[j].pressure*__pm_inv(__pm_sq(ps[j].density))
+		__pm3_assign_c(part_i_to_j,
+			pos_x[i] - pos_x[j], pos_y[i] - pos_y[j], pos_z[i] - pos_z[j]);
+		float Pij = -masses[j]*(
+			press_i + pressures[j]*__pm_inv(__pm_sq(densities[j]))
 		);
 		kernel_pressure(part_i_to_j, d2, pressure_dir);
 		__pm3_assign_vs(press_acc, pressure_dir,Pij);
@@ -215,9 +274,12 @@ void newtonian::update_force
 #endif
 
 		/* viscosity acceleration */
-		float Vij = viscosity*ps[j].mass*__pm_inv(ps[i].density*ps[j].density);
+		float Vij = viscosity*masses[j]*__pm_inv(densities[i]*densities[j]);
 		Vij *= kernel_viscosity(d2);
-		__pm3_sub_v_v_mul_s(visc_acc, ps[j].cur_vel,ps[i].cur_vel, Vij);
+		__pm3_assign_c(visc_acc,
+			(vel_x[j] - vel_x[i])*Vij,
+			(vel_y[j] - vel_y[i])*Vij,
+			(vel_z[j] - vel_z[i])*Vij);
 		__pm3_add_acc_v(acc, visc_acc);
 
 #if OUTPUT_ACCEL_VISC == 1
@@ -237,16 +299,59 @@ void newtonian::update_force
 	}
 
 	/* compute force in particle*/
-	__pm3_assign_vs(ps[i].force, acc, ps[i].mass);
+	__pm3_assign_vs(ps[i].force, acc, masses[i]);
 
 #if OUTPUT_FORCE == 1
 	cout << "    total force= " << __pm3_out(ps[i].force) << endl;
 #endif
 }
 
+void newtonian::update_force_pairs(size_t i, vec3 *forces) {
+	/* force between the i-th and the j-th particles */
+	vec3 force;
+	/* auxiliary vectors */
+	vec3 part_i_to_j, pressure_dir, visc_force;
+
+	/* pressure term of the i-th particle */
+	const float press_i = pressures[i]*__pm_inv(__pm_sq(densities[i]));
+
+	for (size_t j_it = neighs_begin[i]; j_it < neighs_begin[i + 1]; ++j_it) {
+		size_t j = neighs[j_it];
+		if (j < i) {
+			// this pair was computed with the j-th particle
+			continue;
+		}
+		float d2 = neighs_d2[j_it];
+
+		/* pressure force (see update_force) */
+		__pm3_assign_c(part_i_to_j,
+			pos_x[i] - pos_x[j], pos_y[i] - pos_y[j], pos_z[i] - pos_z[j]);
+		float Pij = -masses[i]*masses[j]*(
+			press_i + pressures[j]*__pm_inv(__pm_sq(densities[j]))
+		);
+		kernel_pressure(part_i_to_j, d2, pressure_dir);
+		__pm3_assign_vs(force, pressure_dir,Pij);
+
+		/* viscosity force */
+		float Vij = viscosity*masses[i]*masses[j]*
+					__pm_inv(densities[i]*densities[j]);
+		Vij *= kernel_viscosity(d2);
+		__pm3_assign_c(visc_force,
+			(vel_x[j] - vel_x[i])*Vij,
+			(vel_y[j] - vel_y[i])*Vij,
+			(vel_z[j] - vel_z[i])*Vij);
+		__pm3_add_acc_v(force, visc_force);
+
+		/* equal and opposite forces */
+		__pm3_add_acc_v(forces[i], force);
+		__pm3_sub_acc_v(forces[j], force);
+	}
+}
+
 // PUBLIC
 
 newtonian::newtonian() : fluid() {
+	symmetric_forces = false;
 }
 
 newtonian::~newtonian() {
@@ -261,23 +366,7 @@ void newtonian::update_forces() {
 
 	// Compute neighbour lists, and squared distances
 	// between a particle and its neighbours.
-	// We need a dynamic list for the neighbours, but a
-	// fixed-size list of these lists will suffice.
-	vector<vector<size_t> > all_neighs(N);
-	vector<vector<float> > all_d2s(N);
-
-#if SAFE_NEIGH == 1
-	for (size_t i = 0; i < N; ++i) {
-		make_neighbours_lists(i, all_neighs[i], all_d2s[i]);
-	}
-#endif
-
-#if EXPL_NEIGH == 1
-	make_partition();
-	for (size_t i = 0; i < N; ++i) {
-		make_neighbours_lists_tree(i, all_neighs[i], all_d2s[i]);
-	}
-#endif
+	make_neighbours_lists(1);
 
 #if OUTPUT > 0
 	cout << "Density and pressure" << endl;
@@ -285,7 +374,7 @@ void newtonian::update_forces() {
 
 	// compute density and pressure of each particle
 	for (size_t i = 0; i < N; ++i) {
-		initialise_density_pressure(i, all_neighs[i], all_d2s[i]);
+		initialise_density_pressure(i);
 	}
 
 #if OUTPUT_ACCEL_FORCE > 0
@@ -293,8 +382,17 @@ void newtonian::update_forces() {
 #endif
 
 	// compute forces of the fluid (due to pressure and viscosity)
-	for (size_t i = 0; i < N; ++i) {
-		update_force(i, all_neighs[i], all_d2s[i]);
+	if (symmetric_forces) {
+		update_forces_pairs(1,
+			[this](size_t i, vec3 *forces) -> void {
+				update_force_pairs(i, forces);
+			}
+		);
+	}
+	else {
+		for (size_t i = 0; i < N; ++i) {
+			update_force(i);
+		}
 	}
 
 #if OUTPUT > 0
@@ -310,41 +408,44 @@ void newtonian::update_forces(size_t n) {
 
 	// Compute neighbour lists, and squared distances
 	// between a particle and its neighbours.
-	// We need a dynamic list for the neighbours, but a
-	// fixed-size list of these lists will suffice.
-	vector<vector<size_t> > all_neighs(N);
-	vector<vector<float> > all_d2s(N);
-
-#if SAFE_NEIGH == 1
-	#pragma omp parallel for num_threads(n)
-	for (size_t i = 0; i < N; ++i) {
-		make_neighbours_lists(i, all_neighs[i], all_d2s[i]);
-	}
-#endif
-
-#if EXPL_NEIGH == 1
-	make_partition();
-	#pragma omp parallel for num_threads(n)
-	for (size_t i = 0; i < N; ++i) {
-		make_neighbours_lists_tree(i, all_neighs[i], all_d2s[i]);
-	}
-#endif
+	make_neighbours_lists(n);
 
 	//cout << "Density and pressure" << endl;
 
 	// compute density and pressure of each particle
 	#pragma omp parallel for num_threads(n)
 	for (size_t i = 0; i < N; ++i) {
-		initialise_density_pressure(i, all_neighs[i], all_d2s[i]);
+		initialise_density_pressure(i);
 	}
 
 	// compute forces of the fluid (due to pressure and viscosity)
-	#pragma omp parallel for num_threads(n)
-	for (size_t i = 0; i < N; ++i) {
-		update_force(i, all_neighs[i], all_d2s[i]);
+	if (symmetric_forces) {
+		update_forces_pairs(n,
+			[this](size_t i, vec3 *forces) -> void {
+				update_force_pairs(i, forces);
+			}
+		);
+	}
+	else {
+		#pragma omp parallel for num_threads(n)
+		for (size_t i = 0; i < N; ++i) {
+			update_force(i);
+		}
 	}
 }
 
+// SETTERS
+
+void newtonian::set_symmetric_forces(bool s) {
+	symmetric_forces = s;
+}
+
+// GETTERS
+
+bool newtonian::get_symmetric_forces() const {
+	return symmetric_forces;
+}
+
 } // -- namespace fluids
 } // -- namespace physim
 
@@ -23,12 +23,18 @@
 
 // C includes
 #include <stddef.h>
+#include <omp.h>
+
+// C++ includes
+#include <vector>
 
 // physim includes
 #include <physim/particles/fluid_particle.hpp>
 #include <physim/fluids/fluid.hpp>
 #include <physim/fluids/kernel_function.hpp>
 #include <physim/structures/octree.hpp>
+#include <physim/math/private/math3.hpp>
+#include <physim/math/vec3.hpp>
 
 namespace physim {
 namespace fluids {
@@ -38,21 +44,81 @@ namespace fluids {
  */
 class newtonian : public fluid {
 	protected:
+		/**
+		 * @brief Compute the forces pairwise.
+		 *
+		 * See @ref set_symmetric_forces.
+		 */
+		bool symmetric_forces;
+		/**
+		 * @brief Force buffers of the threads.
+		 *
+		 * Used only when @ref symmetric_forces is true. The buffer of
+		 * the @e t-th thread occupies the positions [t*N, (t + 1)*N).
+		 */
+		std::vector<math::vec3> thread_forces;
 
-		void make_neighbours_lists
-		(size_t i, std::vector<size_t>& neihgs, std::vector<float>& d2s) const;
+	protected:
 
-		void make_neighbours_lists_tree
-		(size_t i, std::vector<size_t>& neihgs, std::vector<float>& d2s) const;
+		/**
+		 * @brief Iterates over the neighbours of a particle.
+		 *
+		 * Calls @e f(j, d2) for every particle @e j at distance at most
+		 * @ref R from the @e i-th particle, where @e d2 is the squared
+		 * distance between them. The neighbours are found with the
+		 * algorithm set in @ref search.
+		 * @pre @ref make_partition has been called.
+		 */
+		template<class Callback>
+		void iterate_neighbours(size_t i, Callback f) const;
+
+		/**
+		 * @brief Builds the neighbour lists of all particles.
+		 *
+		 * Sorts the particles when needed (see @ref periodic_sort),
+		 * builds the space partition (see @ref make_partition) and
+		 * fills @ref neighs_begin, @ref neighs and @ref neighs_d2 in two
+		 * passes: the neighbours of each particle are first counted,
+		 * and then stored at the positions given by the prefix sum of
+		 * the counts.
+		 * @param n Number of threads.
+		 */
+		void make_neighbours_lists(size_t n);
 
-		void initialise_density_pressure
-		(size_t i, const std::vector<size_t>& neighs, const std::vector<float>& d2s);
+		void initialise_density_pressure(size_t i);
+
+		void update_force(size_t i);
+
+		/**
+		 * @brief Computes the forces between the @e i-th particle and
+		 * its neighbours with a larger index.
+		 *
+		 * The force of every pair is computed once and accumulated
+		 * with opposite signs on both particles.
+		 * @param i Particle.
+		 * @param forces Buffer where the forces are accumulated.
+		 */
+		void update_force_pairs(size_t i, math::vec3 *forces);
 
-		void update_force
-		(size_t i, const std::vector<size_t>& neighs, const std::vector<float>& d2s);
+		/**
+		 * @brief Updates the forces of the particles pairwise.
+		 *
+		 * Calls @e f(i, forces) for every particle @e i, which is
+		 * expected to accumulate in @e forces the forces between the
+		 * @e i-th particle and its neighbours with a larger index
+		 * (see @ref update_force_pairs). Every thread accumulates its
+		 * forces in its own buffer in @ref thread_forces, and these
+		 * are added afterwards.
+		 * @param n Number of threads.
+		 * @param f Function computing the forces of a particle.
+		 * @pre The neighbour lists, the densities and the pressures
+		 * have been computed.
+		 */
+		template<class Callback>
+		void update_forces_pairs(size_t n, Callback f);
 
 	public:
-		/// Default onstructor.
+		/// Default constructor.
 		newtonian();
 		/// Destructor.
 		virtual ~newtonian();
@@ -92,7 +158,67 @@ class newtonian : public fluid {
 		 * acting on the particles due to force fields.
 		 */
 		virtual void update_forces(size_t n);
+
+		// SETTERS
+
+		/**
+		 * @brief Sets whether the forces are computed pairwise.
+		 *
+		 * When @e s is true, the pressure and viscosity forces between
+		 * two neighbouring particles are computed only once, and
+		 * applied with opposite signs to both particles, which
+		 * halves the number of kernel evaluations.
+		 *
+		 * This requires the pressure kernel to be odd, that is, for
+		 * its value at vector @e -r to be the opposite of its value
+		 * at vector @e r. This is the case of the gradient of any
+		 * radial kernel.
+		 *
+		 * By default, forces are not computed pairwise.
+		 * @param s Compute forces pairwise.
+		 */
+		void set_symmetric_forces(bool s);
+
+		// GETTERS
+
+		/// Returns whether forces are computed pairwise.
+		bool get_symmetric_forces() const;
 };
 
+template<class Callback>
+void newtonian::update_forces_pairs(size_t n, Callback f) {
+	// these do not allocate memory if the size does not grow
+	thread_forces.resize(n*N);
+
+	// OpenMP may provide fewer than n threads: only the
+	// slices of the threads actually used are written
+	size_t used = 1;
+
+	#pragma omp parallel num_threads(n) if(n > 1)
+	{
+	#pragma omp single
+	used = static_cast<size_t>(omp_get_num_threads());
+
+	math::vec3 *forces = thread_forces.data() + omp_get_thread_num()*N;
+	for (size_t i = 0; i < N; ++i) {
+		__pm3_assign_s(forces[i], 0.0f);
+	}
+
+	#pragma omp for
+	for (size_t i = 0; i < N; ++i) {
+		f(i, forces);
+	}
+	}
+
+	// add the forces of all threads
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < N; ++i) {
+		__pm3_assign_v(ps[i].force, thread_forces[i]);
+		for (size_t t = 1; t < used; ++t) {
+			__pm3_add_acc_v(ps[i].force, thread_forces[t*N + i]);
+		}
+	}
+}
+
 } // -- namespace fluids
 } // -- namespace physim
@@ -0,0 +1,303 @@
+/*********************************************************************
+ * Real-time physics simulation project
+ * Copyright (C) 2018-2019 Lluís Alemany Puig
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Contact: Lluís Alemany Puig (lluis.alemany.puig@gmail.com)
+ * 
+ ********************************************************************/
+
+#pragma once
+
+// C includes
+#include <stddef.h>
+
+// physim includes
+#include <physim/fluids/newtonian.hpp>
+#include <physim/fluids/kernels.hpp>
+#include <physim/math/private/math3.hpp>
+#include <physim/math/private/numeric.hpp>
+
+namespace physim {
+namespace fluids {
+
+/**
+ * @brief Newtonian fluid with kernel functions fixed at compile time.
+ *
+ * The fluid is simulated exactly like a @ref newtonian fluid, but
+ * the kernel functions are given as template parameters instead of
+ * as function objects (see @ref fluid::kernel_density,
+ * @ref fluid::kernel_pressure, @ref fluid::kernel_viscosity).
+ * Therefore, the functions set with @ref set_kernel_density,
+ * @ref set_kernel_pressure and @ref set_kernel_viscosity are ignored.
+ *
+ * The kernels are built at every time step using the neighbourhood
+ * size @ref R. Their evaluation is inlined in the loops over the
+ * neighbours of each particle, which read the structure-of-arrays
+ * copy of the particles (see @ref pos_x) and are vectorised, that is,
+ * several neighbours are processed at once with SIMD instructions.
+ * How many depends on the instruction set the library is compiled
+ * for: 4 with the default flags of x86-64, which only enable SSE.
+ *
+ * For example, the kernels of Müller et al. (2003):
+ \verbatim
+ templated_newtonian<
+	kernels::density_poly6,
+	kernels::pressure_spiky,
+	kernels::viscosity_spiky
+ > *F = new templated_newtonian<...>();
+ \endverbatim
+ *
+ * @param density_kernel Kernel for the density (see @ref fluid::kernel_density).
+ * @param pressure_kernel Kernel for the pressure (see @ref fluid::kernel_pressure).
+ * @param viscosity_kernel Kernel for the viscosity (see @ref fluid::kernel_viscosity).
+ */
+template<class density_kernel, class pressure_kernel, class viscosity_kernel>
+class templated_newtonian : public newtonian {
+	protected:
+
+		void initialise_density_pressure(size_t i, const density_kernel& W);
+
+		void update_force
+		(size_t i, const pressure_kernel& gW, const viscosity_kernel& g2W);
+
+		void update_force_pairs
+		(size_t i, math::vec3 *forces,
+		 const pressure_kernel& gW, const viscosity_kernel& g2W);
+
+	public:
+		/// Default constructor.
+		templated_newtonian();
+		/// Destructor.
+		virtual ~templated_newtonian();
+
+		// MODIFIERS
+
+		/**
+		 * @brief Update the forces generated within the fluid.
+		 *
+		 * See @ref newtonian::update_forces().
+		 */
+		virtual void update_forces();
+		/**
+		 * @brief Update the forces generated within the fluid.
+		 *
+		 * See @ref newtonian::update_forces(size_t).
+		 * @param n Number of threads
+		 */
+		virtual void update_forces(size_t n);
+};
+
+// PROTECTED
+
+template<class density_kernel, class pressure_kernel, class viscosity_kernel>
+void templated_newtonian<density_kernel, pressure_kernel, viscosity_kernel>::
+initialise_density_pressure(size_t i, const density_kernel& W)
+{
+	const size_t *js = neighs.data() + neighs_begin[i];
+	const float *d2s = neighs_d2.data() + neighs_begin[i];
+	const size_t n_neighs = neighs_begin[i + 1] - neighs_begin[i];
+
+	const float *m = masses.data();
+
+	float dens = 0.0f;
+	#pragma omp simd reduction(+:dens)
+	for (size_t k = 0; k < n_neighs; ++k) {
+		dens += m[js[k]]*W(d2s[k]);
+	}
+	dens += m[i]*W(0.0f);
+
+	densities[i] = dens;
+	pressures[i] = __pm_sq(speed_sound)*(dens - density);
+
+	ps[i].density = densities[i];
+	ps[i].pressure = pressures[i];
+}
+
+template<class density_kernel, class pressure_kernel, class viscosity_kernel>
+void templated_newtonian<density_kernel, pressure_kernel, viscosity_kernel>::
+update_force(size_t i, const pressure_kernel& gW, const viscosity_kernel& g2W)
+{
+	const size_t *js = neighs.data() + neighs_begin[i];
+	const float *d2s = neighs_d2.data() + neighs_begin[i];
+	const size_t n_neighs = neighs_begin[i + 1] - neighs_begin[i];
+
+	const float *px = pos_x.data();
+	const float *py = pos_y.data();
+	const float *pz = pos_z.data();
+	const float *vx = vel_x.data();
+	const float *vy = vel_y.data();
+	const float *vz = vel_z.data();
+	const float *m = masses.data();
+	const float *rho = densities.data();
+	const float *p = pressures.data();
+
+	/* pressure and viscosity terms of the i-th particle */
+	const float press_i = p[i]*__pm_inv(__pm_sq(rho[i]));
+	const float visc_i = viscosity*__pm_inv(rho[i]);
+
+	/* total acceleration */
+	float ax = 0.0f;
+	float ay = 0.0f;
+	float az = 0.0f;
+
+	#pragma omp simd reduction(+:ax,ay,az)
+	for (size_t k = 0; k < n_neighs; ++k) {
+		const size_t j = js[k];
+		const float d2 = d2s[k];
+
+		/* pressure acceleration (see newtonian::update_force) */
+		const float Pij = -m[j]*(press_i + p[j]*__pm_inv(__pm_sq(rho[j])));
+		const float s = Pij*gW.scale(d2);
+		ax += (px[i] - px[j])*s;
+		ay += (py[i] - py[j])*s;
+		az += (pz[i] - pz[j])*s;
+
+		/* viscosity acceleration */
+		const float Vij = visc_i*m[j]*__pm_inv(rho[j])*g2W(d2);
+		ax += (vx[j] - vx[i])*Vij;
+		ay += (vy[j] - vy[i])*Vij;
+		az += (vz[j] - vz[i])*Vij;
+	}
+
+	/* compute force in particle */
+	__pm3_assign_c(ps[i].force, ax*m[i], ay*m[i], az*m[i]);
+}
+
+template<class density_kernel, class pressure_kernel, class viscosity_kernel>
+void templated_newtonian<density_kernel, pressure_kernel, viscosity_kernel>::
+update_force_pairs
+(size_t i, math::vec3 *forces,
+ const pressure_kernel& gW, const viscosity_kernel& g2W)
+{
+	/* pressure and viscosity terms of the i-th particle */
+	const float press_i = pressures[i]*__pm_inv(__pm_sq(densities[i]));
+	const float visc_i = viscosity*masses[i]*__pm_inv(densities[i]);
+
+	/* force between the i-th and the j-th particles */
+	math::vec3 force;
+
+	for (size_t j_it = neighs_begin[i]; j_it < neighs_begin[i + 1]; ++j_it) {
+		const size_t j = neighs[j_it];
+		if (j < i) {
+			// this pair was computed with the j-th particle
+			continue;
+		}
+		const float d2 = neighs_d2[j_it];
+
+		/* pressure force (see newtonian::update_force_pairs) */
+		const float Pij = -masses[i]*masses[j]*
+			(press_i + pressures[j]*__pm_inv(__pm_sq(densities[j])));
+		const float s = Pij*gW.scale(d2);
+
+		/* viscosity force */
+		const float Vij = visc_i*masses[j]*__pm_inv(densities[j])*g2W(d2);
+
+		__pm3_assign_c(force,
+			(pos_x[i] - pos_x[j])*s + (vel_x[j] - vel_x[i])*Vij,
+			(pos_y[i] - pos_y[j])*s + (vel_y[j] - vel_y[i])*Vij,
+			(pos_z[i] - pos_z[j])*s + (vel_z[j] - vel_z[i])*Vij);
+
+		/* equal and opposite forces */
+		__pm3_add_acc_v(forces[i], force);
+		__pm3_sub_acc_v(forces[j], force);
+	}
+}
+
+// PUBLIC
+
+template<class density_kernel, class pressure_kernel, class viscosity_kernel>
+templated_newtonian<density_kernel, pressure_kernel, viscosity_kernel>::
+templated_newtonian() : newtonian()
+{
+}
+
+template<class density_kernel, class pressure_kernel, class viscosity_kernel>
+templated_newtonian<density_kernel, pressure_kernel, viscosity_kernel>::
+~templated_newtonian()
+{
+}
+
+// MODIFIERS
+
+template<class density_kernel, class pressure_kernel, class viscosity_kernel>
+void templated_newtonian<density_kernel, pressure_kernel, viscosity_kernel>::
+update_forces()
+{
+	make_neighbours_lists(1);
+
+	const density_kernel W(R);
+	const pressure_kernel gW(R);
+	const viscosity_kernel g2W(R);
+
+	// compute density and pressure of each particle
+	for (size_t i = 0; i < N; ++i) {
+		initialise_density_pressure(i, W);
+	}
+
+	// compute forces of the fluid (due to pressure and viscosity)
+	if (symmetric_forces) {
+		update_forces_pairs(1,
+			[&](size_t i, math::vec3 *forces) -> void {
+				update_force_pairs(i, forces, gW, g2W);
+			}
+		);
+	}
+	else {
+		for (size_t i = 0; i < N; ++i) {
+			update_force(i, gW, g2W);
+		}
+	}
+}
+
+template<class density_kernel, class pressure_kernel, class viscosity_kernel>
+void templated_newtonian<density_kernel, pressure_kernel, viscosity_kernel>::
+update_forces(size_t n)
+{
+	if (n == 1) {
+		update_forces();
+		return;
+	}
+
+	make_neighbours_lists(n);
+
+	const density_kernel W(R);
+	const pressure_kernel gW(R);
+	const viscosity_kernel g2W(R);
+
+	// compute density and pressure of each particle
+	#pragma omp parallel for num_threads(n)
+	for (size_t i = 0; i < N; ++i) {
+		initialise_density_pressure(i, W);
+	}
+
+	// compute forces of the fluid (due to pressure and viscosity)
+	if (symmetric_forces) {
+		update_forces_pairs(n,
+			[&](size_t i, math::vec3 *forces) -> void {
+				update_force_pairs(i, forces, gW, g2W);
+			}
+		);
+	}
+	else {
+		#pragma omp parallel for num_threads(n)
+		for (size_t i = 0; i < N; ++i) {
+			update_force(i, gW, g2W);
+		}
+	}
+}
+
+} // -- namespace fluids
+} // -- namespace physim
@@ -25,7 +25,6 @@
 #include <assert.h>
 
 // C++ includes
-#include <algorithm>
 #include <iostream>
 using namespace std;
 
@@ -39,6 +38,41 @@ namespace geometric {
 
 // PRIVATE
 
+size_t object::closest_triangle
+(const vec3& p1, const vec3& p2, vec3& p_inter) const
+{
+	const vec3 d = p2 - p1;
+	const float d2 = __pm3_norm2(d);
+
+	size_t closest = tris.size();
+	float t_closest = 2.0f;
+
+	// The triangles within a cell are not sorted along the segment,
+	// and a triangle spanning several cells is visited only in the
+	// first of them: every intersection in a cell has to be tested,
+	// and the visit stops only when the closest one is in that cell.
+	octree.visit_segment(p1, p2,
+		[&](size_t t_idx) -> bool {
+			vec3 q;
+			if (tris[t_idx/3].intersec_segment(p1, p2, q)) {
+				vec3 dq;
+				__pm3_sub_v_v(dq, q, p1);
+				const float t = (d2 > 0.0f ? __pm3_dot(dq, d)/d2 : 0.0f);
+				if (t < t_closest) {
+					closest = t_idx/3;
+					t_closest = t;
+					__pm3_assign_v(p_inter, q);
+				}
+			}
+			return false;
+		},
+		[&](float te) -> bool {
+			return t_closest <= te;
+		}
+	);
+	return closest;
+}
+
 // PUBLIC
 
 object::object() : geometry() {
@@ -64,7 +98,7 @@ void object::set_position(const vec3& dir) {
 }
 
 void object::set_triangles
-(const std::vector<vec3>& vs, const std::vector<size_t>& trs)
+(const std::vector<vec3>& vs, const std::vector<size_t>& trs, size_t n)
 {
 	assert(trs.size()%3 == 0);
 
@@ -79,7 +113,7 @@ void object::set_triangles
 		__pm3_max4(vmax, vmax, vs[i1], vs[i2], vs[i3]);
 	}
 
-	octree.init(vs, trs);
+	octree.init(vs, trs, 8, n);
 }
 
 // GETTERS
@@ -102,63 +136,31 @@ bool object::is_inside(const vec3& p, float tol) const {
 		return false;
 	}
 
-	vector<size_t> idxs;
-	octree.get_indices(p, idxs);
-	for (size_t t_idx : idxs) {
-		if (tris[t_idx/3].is_inside(p, tol)) {
-			return true;
+	return octree.visit_indices(p,
+		[&](size_t t_idx) -> bool {
+			return tris[t_idx/3].is_inside(p, tol);
 		}
-	}
-	return false;
+	);
 }
 
 bool object::intersec_segment(const vec3& p1, const vec3& p2) const {
-	// assuming a small time step value this code,
-	// although not correct, is good enough for
-	// object-segment intersection test
-
-	vector<size_t> idxs;
-	octree.get_indices(p1, idxs);
-	octree.get_indices(p2, idxs);
-	sort(idxs.begin(), idxs.end());
-	auto last = unique(idxs.begin(), idxs.end());
-	idxs.erase(last, idxs.end());
-	for (size_t t_idx : idxs) {
-		if (tris[t_idx/3].intersec_segment(p1,p2)) {
-			return true;
+	return octree.visit_segment(p1, p2,
+		[&](size_t t_idx) -> bool {
+			return tris[t_idx/3].intersec_segment(p1,p2);
 		}
-	}
-	return false;
+	);
 }
 
 bool object::intersec_sphere(const vec3& c, float R) const {
-	vector<size_t> idxs;
-	octree.get_indices(c, idxs);
-	for (size_t t_idx : idxs) {
-		if (tris[t_idx/3].intersec_sphere(c,R)) {
-			return true;
+	return octree.visit_indices(c,
+		[&](size_t t_idx) -> bool {
+			return tris[t_idx/3].intersec_sphere(c,R);
 		}
-	}
-	return false;
+	);
 }
 
 bool object::intersec_segment(const vec3& p1, const vec3& p2, vec3& p_inter) const {
-	// assuming a small time step value this code,
-	// although not correct, is good enough for
-	// object-segment intersection test
-
-	vector<size_t> idxs;
-	octree.get_indices(p1, idxs);
-	octree.get_indices(p2, idxs);
-	sort(idxs.begin(), idxs.end());
-	auto last = unique(idxs.begin(), idxs.end());
-	idxs.erase(last, idxs.end());
-	for (size_t t_idx : idxs) {
-		if (tris[t_idx/3].intersec_segment(p1,p2,p_inter)) {
-			return true;
-		}
-	}
-	return false;
+	return closest_triangle(p1, p2, p_inter) < tris.size();
 }
 
 // OTHERS
@@ -175,16 +177,16 @@ bool object::update_particle(
 	const particles::free_particle& p, particles::free_particle& u
 ) const
 {
-	vector<size_t> idxs;
-	octree.get_indices(pred_pos, idxs);
-	for (size_t t_idx : idxs) {
-		if (tris[t_idx/3].intersec_segment(p.cur_pos, pred_pos)) {
-			u = p;
-			tris[t_idx/3].update_particle(pred_pos, pred_vel, u);
-			return true;
-		}
+	// the first triangle crossed by the particle's path
+	vec3 p_inter;
+	const size_t t = closest_triangle(p.cur_pos, pred_pos, p_inter);
+	if (t == tris.size()) {
+		return false;
 	}
-	return false;
+
+	u = p;
+	tris[t].update_particle(pred_pos, pred_vel, u);
+	return true;
 }
 
 void object::update_particle(
@@ -200,16 +202,16 @@ bool object::update_particle(
 	const particles::sized_particle& p, particles::sized_particle& u
 ) const
 {
-	vector<size_t> idxs;
-	octree.get_indices(pred_pos, p.R, idxs);
-	for (size_t t_idx : idxs) {
-		if (tris[t_idx/3].intersec_sphere(pred_pos, p.R)) {
-			u = p;
-			tris[t_idx/3].update_particle(pred_pos, pred_vel, u);
-			return true;
+	return octree.visit_indices(pred_pos, p.R,
+		[&](size_t t_idx) -> bool {
+			if (tris[t_idx/3].intersec_sphere(pred_pos, p.R)) {
+				u = p;
+				tris[t_idx/3].update_particle(pred_pos, pred_vel, u);
+				return true;
+			}
+			return false;
 		}
-	}
-	return false;
+	);
 }
 
 void object::display() const {
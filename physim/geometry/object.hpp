@@ -48,6 +48,19 @@ class object : public geometry {
 		/// Partition of the object for faster intersection tests.
 		structures::octree octree;
 
+	private:
+		/**
+		 * @brief Finds the triangle intersected by a segment closest
+		 * to its first endpoint.
+		 * @param[in] p1 First endpoint of the segment.
+		 * @param[in] p2 Second endpoint of the segment.
+		 * @param[out] p_inter Intersection point with the triangle.
+		 * @returns Returns the index in @ref tris of the triangle, or
+		 * the size of @ref tris if the segment intersects none.
+		 */
+		size_t closest_triangle
+		(const math::vec3& p1, const math::vec3& p2, math::vec3& p_inter) const;
+
 	public:
 		/// Default constructor.
 		object();
@@ -77,9 +90,12 @@ class object : public geometry {
 		 * @param vs Vertices of the object.
 		 * @param trs Triangles of the object. This contains indices pointing
 		 * to vertices in @e vs. Every three values we have a triangle.
+		 * @param n Number of threads used to construct the partition.
 		 */
-		void set_triangles
-		(const std::vector<math::vec3>& vs, const std::vector<size_t>& trs);
+		void set_triangles(
+			const std::vector<math::vec3>& vs, const std::vector<size_t>& trs,
+			size_t n = 1
+		);
 
 		// GETTERS
 
@@ -43,7 +43,8 @@ namespace input {
 	(
 		const std::string& directory,
 		const std::string& filename,
-		geometric::object *mesh
+		geometric::object *mesh,
+		size_t n
 	)
 	{
 		// retrieve extension
@@ -65,15 +66,15 @@ namespace input {
 
 		if (extension == "obj") {
 			// read .obj file
-			return obj_read_file(directory, filename, mesh);
+			return obj_read_file(directory, filename, mesh, n);
 		}
 		if (extension == "ply") {
 			// read .obj file
-			return ply_read_file(directory, filename, mesh);
+			return ply_read_file(directory, filename, mesh, n);
 		}
 		if (extension == "soup") {
 			// read .soup file
-			return soup_read_file(directory, filename, mesh);
+			return soup_read_file(directory, filename, mesh, n);
 		}
 
 		#if defined(DEBUG)
@@ -50,13 +50,16 @@ namespace input {
 	 * @param directory Directory that contains the file to be read.
 	 * @param filename The filename describing the object.
 	 * @param[out] mesh Object constructed with the contents of the file.
+	 * @param n Number of threads used to partition the object (see
+	 * @ref geometric::object::set_triangles).
 	 * @return Returns true on success.
 	 */
 	bool read_file
 	(
 		const std::string& directory,
 		const std::string& filename,
-		geometric::object *mesh
+		geometric::object *mesh,
+		size_t n = 1
 	);
 
 	/**
@@ -159,7 +159,7 @@ namespace input_private {
 } // -- namespace io_private
 
 	bool obj_read_file
-	(const std::string& dir, const std::string& fname, geometric::object *o)
+	(const std::string& dir, const std::string& fname, geometric::object *o, size_t n)
 	{
 		assert(o != nullptr);
 
@@ -186,7 +186,7 @@ namespace input_private {
 		input_private::__obj_parse_file_lines(fin, vertices, triangles);
 		fin.close();
 
-		o->set_triangles(vertices, triangles);
+		o->set_triangles(vertices, triangles, n);
 		return true;
 	}
 
@@ -38,11 +38,13 @@ namespace input {
 	 * @param directory Directory in the system.
 	 * @param filename File with the mesh in wavefront (obj) format.
 	 * @param[out] o Mesh loaded from file.
+	 * @param n Number of threads used to partition the object (see
+	 * @ref geometric::object::set_triangles).
 	 * @return Returns false on error.
 	 */
 	bool obj_read_file
 	(const std::string& directory, const std::string& filename,
-	 geometric::object *o);
+	 geometric::object *o, size_t n = 1);
 
 } // -- namespace io
 } // -- namespace physim
@@ -196,7 +196,8 @@ namespace input_private {
 
 } // -- namespace io_private
 
-	bool ply_read_file(const std::string& dir, const std::string& fname, geometric::object *o)
+	bool ply_read_file
+	(const std::string& dir, const std::string& fname, geometric::object *o, size_t n)
 	{
 		assert(o != nullptr);
 
@@ -249,7 +250,7 @@ namespace input_private {
 		}
 		fin.close();
 
-		o->set_triangles(vertices, triangles);
+		o->set_triangles(vertices, triangles, n);
 		return true;
 	}
 
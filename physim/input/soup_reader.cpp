@@ -35,7 +35,7 @@ namespace physim {
 namespace input {
 
 	bool soup_read_file
-	(const std::string& dir, const std::string& fname, geometric::object *o)
+	(const std::string& dir, const std::string& fname, geometric::object *o, size_t n)
 	{
 		assert(o != nullptr);
 
@@ -76,7 +76,7 @@ namespace input {
 		assert(vertices.size()%3 == 0);
 		#endif
 
-		o->set_triangles(vertices, triangles);
+		o->set_triangles(vertices, triangles, n);
 		return true;
 	}
 
@@ -37,11 +37,13 @@ namespace input {
 	 * @param filename File with the mesh as a triangle soup
 	 * (soup) format.
 	 * @param[out] o Mesh loaded from file.
+	 * @param n Number of threads used to partition the object (see
+	 * @ref geometric::object::set_triangles).
 	 * @return Returns false on error.
 	 */
 	bool soup_read_file
 	(const std::string& directory, const std::string& filename,
-	 geometric::object *o);
+	 geometric::object *o, size_t n = 1);
 
 } // -- namespace io
 } // -- namespace physim
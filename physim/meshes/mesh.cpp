@@ -23,17 +23,122 @@
 
 // C includes
 #include <assert.h>
+#include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 // C++ includes
+#include <algorithm>
 #include <iostream>
+#include <limits>
 using namespace std;
 
+// physim includes
+#include <physim/math/private/math3.hpp>
+
 namespace physim {
 using namespace particles;
+using namespace math;
 
 namespace meshes {
 
+// PROTECTED
+
+void mesh::make_springs() {
+	springs.clear();
+}
+
+void mesh::update_springs(bool colour) {
+	if (not springs_valid) {
+		make_springs();
+		spring_colours.clear();
+		springs_valid = true;
+	}
+	if (colour and spring_colours.size() == 0) {
+		colour_springs();
+	}
+}
+
+void mesh::invalidate_springs() {
+	springs_valid = false;
+	spring_colours.clear();
+	stable_dt = -1.0f;
+}
+
+void mesh::colour_springs() {
+	// colours used by the springs of every particle, one bit
+	// per colour: the springs of a particle in a mesh are few
+	vector<uint64_t> used(N, 0);
+	vector<size_t> colour(springs.size());
+
+	size_t n_colours = 0;
+	for (size_t s = 0; s < springs.size(); ++s) {
+		const size_t i = springs[s].i;
+		const size_t j = springs[s].j;
+
+		// smallest colour not used by the springs of i and j
+		const uint64_t free_colours = ~(used[i] | used[j]);
+		assert(free_colours != 0);
+		size_t c = 0;
+		while (((free_colours >> c) & 1) == 0) {
+			++c;
+		}
+
+		colour[s] = c;
+		used[i] |= (uint64_t(1) << c);
+		used[j] |= (uint64_t(1) << c);
+		n_colours = std::max(n_colours, c + 1);
+	}
+
+	// sort the springs by colour (counting sort)
+	spring_colours.assign(n_colours + 1, 0);
+	for (size_t s = 0; s < springs.size(); ++s) {
+		++spring_colours[colour[s] + 1];
+	}
+	for (size_t c = 1; c <= n_colours; ++c) {
+		spring_colours[c] += spring_colours[c - 1];
+	}
+
+	vector<size_t> pos(spring_colours.begin(), spring_colours.end() - 1);
+	vector<spring> sorted(springs.size());
+	for (size_t s = 0; s < springs.size(); ++s) {
+		sorted[pos[colour[s]]] = springs[s];
+		++pos[colour[s]];
+	}
+	springs.swap(sorted);
+}
+
+void mesh::multiply_system(const vector<vec3>& d, vector<vec3>& q) const {
+	// mass matrix
+	for (size_t i = 0; i < N; ++i) {
+		__pm3_mul_v_s(q[i], d[i], ps[i].mass);
+	}
+
+	// the block B of a spring appears as +B in the diagonal
+	// blocks of its particles and as -B in the other two
+	vec3 dd, Bd;
+	for (size_t s = 0; s < springs.size(); ++s) {
+		const size_t i = springs[s].i;
+		const size_t j = springs[s].j;
+		const float *B = &spring_jacobian[6*s];
+
+		__pm3_sub_v_v(dd, d[i], d[j]);
+		__pm3_assign_c(Bd,
+			B[0]*dd.x + B[1]*dd.y + B[2]*dd.z,
+			B[1]*dd.x + B[3]*dd.y + B[4]*dd.z,
+			B[2]*dd.x + B[4]*dd.y + B[5]*dd.z);
+		__pm3_add_acc_v(q[i], Bd);
+		__pm3_sub_acc_v(q[j], Bd);
+	}
+
+	// fixed particles are filtered out of the system
+	for (size_t i = 0; i < N; ++i) {
+		if (ps[i].fixed) {
+			__pm3_assign_s(q[i], 0.0f);
+		}
+	}
+}
+
 // PUBLIC
 
 mesh::mesh() {
@@ -43,6 +148,13 @@ mesh::mesh() {
 	bouncing = 0.8f;
 	Ke = 100.0f;
 	Kd = 0.05f;
+	implicit = false;
+	cg_iterations = 100;
+	cg_tolerance = 1e-4f;
+	position_based = false;
+	pbd_iterations = 10;
+	springs_valid = false;
+	stable_dt = -1.0f;
 }
 mesh::mesh(float ke, float kd) {
 	N = 0;
@@ -51,6 +163,13 @@ mesh::mesh(float ke, float kd) {
 	bouncing = 0.8f;
 	Ke = ke;
 	Kd = kd;
+	implicit = false;
+	cg_iterations = 100;
+	cg_tolerance = 1e-4f;
+	position_based = false;
+	pbd_iterations = 10;
+	springs_valid = false;
+	stable_dt = -1.0f;
 }
 
 mesh::~mesh() {
@@ -99,6 +218,8 @@ void mesh::allocate(size_t n, float Kg) {
 		ps[i].index = i;
 		ps[i].mass = Kg/N;
 	}
+
+	invalidate_springs();
 }
 
 void mesh::clear() {
@@ -106,12 +227,232 @@ void mesh::clear() {
 		free(ps);
 		ps = nullptr;
 	}
+	invalidate_springs();
+}
+
+void mesh::update_forces(size_t) {
+	update_forces();
+}
+
+void mesh::solve_implicit(float dt, vec3 *dv) {
+	assert(ps != nullptr);
+
+	update_springs();
+
+	spring_jacobian.resize(6*springs.size());
+	cg_precond.resize(N);
+	cg_r.resize(N);
+	cg_d.resize(N);
+	cg_q.resize(N);
+	cg_s.resize(N);
+
+	// 1. Right-hand side: dt*f. Diagonal of the matrix: the masses.
+	for (size_t i = 0; i < N; ++i) {
+		__pm3_mul_v_s(cg_r[i], ps[i].force, dt);
+		__pm3_assign_s(cg_precond[i], ps[i].mass);
+	}
+
+	// 2. Jacobians of the springs. With
+	//     n: direction from particle i to particle j
+	//     l: length of the spring, L: rest length
+	// the Jacobian of the force on particle i with respect to
+	// the position of particle j is
+	//     K = Ke*(c*I + (1 - c)*n*n^T), c = 1 - L/l,
+	// where c is clamped to 0 when the spring is compressed so
+	// that the matrix is positive definite, and with respect to
+	// the velocity of particle j is
+	//     Kd*n*n^T.
+	// The block of the spring in the matrix is
+	//     B = dt*Kd*n*n^T + dt^2*K
+	// and the right-hand side gets dt^2*K*(v_j - v_i) in particle
+	// i and its opposite in particle j.
+	const float dt2 = dt*dt;
+	vec3 n, dvel, Kv;
+	for (size_t s = 0; s < springs.size(); ++s) {
+		const size_t i = springs[s].i;
+		const size_t j = springs[s].j;
+
+		__pm3_sub_v_v(n, ps[j].cur_pos, ps[i].cur_pos);
+		const float l = __pm3_norm(n);
+		if (l <= 0.0f) {
+			fill(&spring_jacobian[6*s], &spring_jacobian[6*s] + 6, 0.0f);
+			continue;
+		}
+		__pm3_div_v_s(n, n, l);
+
+		const float c = std::max(0.0f, 1.0f - springs[s].d/l);
+		const float kI = Ke*c;
+		const float kn = Ke*(1.0f - c);
+
+		// K = kI*I + kn*n*n^T
+		const float K[6] = {
+			kI + kn*n.x*n.x, kn*n.x*n.y, kn*n.x*n.z,
+			kI + kn*n.y*n.y, kn*n.y*n.z,
+			kI + kn*n.z*n.z
+		};
+
+		__pm3_sub_v_v(dvel, ps[j].cur_vel, ps[i].cur_vel);
+		__pm3_assign_c(Kv,
+			K[0]*dvel.x + K[1]*dvel.y + K[2]*dvel.z,
+			K[1]*dvel.x + K[3]*dvel.y + K[4]*dvel.z,
+			K[2]*dvel.x + K[4]*dvel.y + K[5]*dvel.z);
+		__pm3_add_acc_vs(cg_r[i], Kv, dt2);
+		__pm3_add_acc_vs(cg_r[j], Kv, -dt2);
+
+		float *B = &spring_jacobian[6*s];
+		B[0] = dt2*K[0] + dt*Kd*n.x*n.x;
+		B[1] = dt2*K[1] + dt*Kd*n.x*n.y;
+		B[2] = dt2*K[2] + dt*Kd*n.x*n.z;
+		B[3] = dt2*K[3] + dt*Kd*n.y*n.y;
+		B[4] = dt2*K[4] + dt*Kd*n.y*n.z;
+		B[5] = dt2*K[5] + dt*Kd*n.z*n.z;
+
+		const vec3 diag(B[0], B[3], B[5]);
+		__pm3_add_acc_v(cg_precond[i], diag);
+		__pm3_add_acc_v(cg_precond[j], diag);
+	}
+
+	// 3. Preconditioned conjugate gradient, starting at dv = 0.
+	// Fixed particles are filtered out: their residual is 0.
+	float delta = 0.0f;
+	float b2 = 0.0f;
+	for (size_t i = 0; i < N; ++i) {
+		__pm3_assign_s(dv[i], 0.0f);
+		if (ps[i].fixed) {
+			__pm3_assign_s(cg_r[i], 0.0f);
+		}
+		__pm3_assign_c(cg_precond[i],
+			1.0f/cg_precond[i].x, 1.0f/cg_precond[i].y, 1.0f/cg_precond[i].z);
+
+		__pm3_mul_v_v(cg_s[i], cg_precond[i], cg_r[i]);
+		__pm3_assign_v(cg_d[i], cg_s[i]);
+		delta += __pm3_dot(cg_r[i], cg_s[i]);
+		b2 += __pm3_dot(cg_r[i], cg_r[i]);
+	}
+
+	const float tol2 = cg_tolerance*cg_tolerance*b2;
+	for (size_t it = 0; it < cg_iterations; ++it) {
+		float r2 = 0.0f;
+		for (size_t i = 0; i < N; ++i) {
+			r2 += __pm3_dot(cg_r[i], cg_r[i]);
+		}
+		if (r2 <= tol2) {
+			break;
+		}
+
+		multiply_system(cg_d, cg_q);
+
+		float dq = 0.0f;
+		for (size_t i = 0; i < N; ++i) {
+			dq += __pm3_dot(cg_d[i], cg_q[i]);
+		}
+		if (dq <= 0.0f) {
+			break;
+		}
+		const float alpha = delta/dq;
+
+		float new_delta = 0.0f;
+		for (size_t i = 0; i < N; ++i) {
+			__pm3_add_acc_vs(dv[i], cg_d[i], alpha);
+			__pm3_add_acc_vs(cg_r[i], cg_q[i], -alpha);
+			__pm3_mul_v_v(cg_s[i], cg_precond[i], cg_r[i]);
+			new_delta += __pm3_dot(cg_r[i], cg_s[i]);
+		}
+
+		const float beta = new_delta/delta;
+		for (size_t i = 0; i < N; ++i) {
+			__pm3_add_v_vs(cg_d[i], cg_s[i], cg_d[i], beta);
+		}
+		delta = new_delta;
+	}
+}
+
+void mesh::solve_constraints(float dt, vec3 *x, size_t n) {
+	assert(ps != nullptr);
+
+	update_springs(true);
+	pbd_lambda.assign(springs.size(), 0.0f);
+
+	// compliance and damping of the constraints (see the paper)
+	const float alpha = (Ke > 0.0f ? 1.0f/(Ke*dt*dt) : 0.0f);
+	const float gamma = (Ke > 0.0f ? Kd/(Ke*dt) : 0.0f);
+
+	const size_t n_colours =
+		(spring_colours.size() > 0 ? spring_colours.size() - 1 : 0);
+
+	for (size_t it = 0; it < pbd_iterations; ++it) {
+		for (size_t c = 0; c < n_colours; ++c) {
+
+			// the springs of the same colour do not share particles
+			#pragma omp parallel for num_threads(n) if(n > 1)
+			for (size_t s = spring_colours[c]; s < spring_colours[c + 1]; ++s) {
+				const size_t i = springs[s].i;
+				const size_t j = springs[s].j;
+
+				const float wi = (ps[i].fixed ? 0.0f : 1.0f/ps[i].mass);
+				const float wj = (ps[j].fixed ? 0.0f : 1.0f/ps[j].mass);
+				if (wi + wj <= 0.0f) {
+					continue;
+				}
+
+				vec3 dir;
+				__pm3_sub_v_v(dir, x[j], x[i]);
+				const float l = __pm3_norm(dir);
+				if (l <= 0.0f) {
+					continue;
+				}
+				__pm3_div_v_s(dir, dir, l);
+
+				// displacement of the particles in this step,
+				// projected onto the constraint's gradient
+				vec3 disp;
+				__pm3_sub_v_v(disp, x[j], ps[j].cur_pos);
+				__pm3_sub_acc_v(disp, x[i]);
+				__pm3_add_acc_v(disp, ps[i].cur_pos);
+
+				const float C = l - springs[s].d;
+				const float dlambda =
+					(-C - alpha*pbd_lambda[s] - gamma*__pm3_dot(dir, disp))/
+					((1.0f + gamma)*(wi + wj) + alpha);
+				pbd_lambda[s] += dlambda;
+
+				__pm3_add_acc_vs(x[i], dir, -wi*dlambda);
+				__pm3_add_acc_vs(x[j], dir, wj*dlambda);
+			}
+		}
+	}
+}
+
+float mesh::compute_stable_time_step() {
+	assert(ps != nullptr);
+
+	if (stable_dt >= 0.0f) {
+		return stable_dt;
+	}
+
+	update_springs();
+
+	vector<size_t> n_springs(N, 0);
+	for (const spring& s : springs) {
+		++n_springs[s.i];
+		++n_springs[s.j];
+	}
+
+	float w2 = 0.0f;
+	for (size_t i = 0; i < N; ++i) {
+		if (not ps[i].fixed) {
+			w2 = std::max(w2, 2.0f*n_springs[i]*Ke/ps[i].mass);
+		}
+	}
+	stable_dt = (w2 > 0.0f ? 2.0f/sqrtf(w2) : numeric_limits<float>::max());
+	return stable_dt;
 }
 
 // SETTERS
 
 void mesh::set_elasticity(float ke) {
 	Ke = ke;
+	stable_dt = -1.0f;
 }
 void mesh::set_damping(float kd) {
 	Kd = kd;
@@ -140,18 +481,66 @@ float mesh::get_bouncing() const {
 	return bouncing;
 }
 
+void mesh::set_implicit(bool i) {
+	implicit = i;
+	if (implicit) {
+		position_based = false;
+	}
+}
+
+void mesh::set_cg_iterations(size_t it) {
+	cg_iterations = it;
+}
+
+void mesh::set_cg_tolerance(float tol) {
+	assert(tol > 0.0f);
+	cg_tolerance = tol;
+}
+
+void mesh::set_position_based(bool p) {
+	position_based = p;
+	if (position_based) {
+		implicit = false;
+	}
+}
+
+void mesh::set_pbd_iterations(size_t it) {
+	pbd_iterations = it;
+}
+
 void mesh::set_mass(float Kg) {
 	assert(ps != nullptr);
 
 	for (size_t i = 0; i < N; ++i) {
 		ps[i].mass = Kg/N;
 	}
+	stable_dt = -1.0f;
 }
 
 size_t mesh::size() const {
 	return N;
 }
 
+bool mesh::is_implicit() const {
+	return implicit;
+}
+
+size_t mesh::get_cg_iterations() const {
+	return cg_iterations;
+}
+
+float mesh::get_cg_tolerance() const {
+	return cg_tolerance;
+}
+
+bool mesh::is_position_based() const {
+	return position_based;
+}
+
+size_t mesh::get_pbd_iterations() const {
+	return pbd_iterations;
+}
+
 const mesh_type& mesh::get_type() const {
 	return mt;
 }
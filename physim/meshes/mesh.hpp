@@ -23,9 +23,11 @@
 
 // C++ includes
 #include <cstdint>
+#include <vector>
 
 // physim includes
 #include <physim/particles/mesh_particle.hpp>
+#include <physim/math/vec3.hpp>
 
 namespace physim {
 namespace meshes {
@@ -75,8 +77,29 @@ enum class mesh_type : int8_t {
  *
  * There are internal forces that can be simulated. These are
  * dependent on each type of mesh.
+ *
+ * A mesh can be integrated implicitly (see @ref set_implicit), so
+ * that stiff springs can be simulated with large time steps. It can
+ * also be simulated with position-based dynamics (see
+ * @ref set_position_based), in which case its springs are treated
+ * as distance constraints instead of forces.
  */
 class mesh {
+	protected:
+		/**
+		 * @brief A spring between two particles of the mesh.
+		 *
+		 * Used to integrate the mesh implicitly (see @ref make_springs).
+		 */
+		struct spring {
+			/// Index of the first particle.
+			size_t i;
+			/// Index of the second particle.
+			size_t j;
+			/// Rest length of the spring.
+			float d;
+		};
+
 	protected:
 		/// The type of this mesh.
 		mesh_type mt;
@@ -96,6 +119,109 @@ class mesh {
 		/// Friction coefficient of all the particles in the mesh.
 		float friction;
 
+		/// Is this mesh integrated implicitly? (see @ref solve_implicit).
+		bool implicit;
+		/// Maximum number of iterations of the conjugate gradient.
+		size_t cg_iterations;
+		/// Relative tolerance of the conjugate gradient's residual.
+		float cg_tolerance;
+
+		/// Springs of the mesh. Filled by @ref make_springs.
+		std::vector<spring> springs;
+		/// Is @ref springs up to date? (see @ref update_springs).
+		bool springs_valid;
+		/**
+		 * @brief Largest stable time step of the mesh.
+		 *
+		 * Cached by @ref compute_stable_time_step. Negative when it
+		 * has to be computed again.
+		 */
+		float stable_dt;
+		/**
+		 * @brief Jacobian of the springs.
+		 *
+		 * Six values per spring: the upper triangle of the symmetric
+		 * 3x3 block of the spring in the matrix of the linear system
+		 * (see @ref solve_implicit).
+		 */
+		std::vector<float> spring_jacobian;
+		/// Inverse of the diagonal of the linear system (preconditioner).
+		std::vector<math::vec3> cg_precond;
+		/// Right-hand side and residual of the conjugate gradient.
+		std::vector<math::vec3> cg_r;
+		/// Search direction of the conjugate gradient.
+		std::vector<math::vec3> cg_d;
+		/// Product of the system's matrix and the search direction.
+		std::vector<math::vec3> cg_q;
+		/// Preconditioned residual of the conjugate gradient.
+		std::vector<math::vec3> cg_s;
+
+		/// Is this mesh simulated with position-based dynamics? (see @ref solve_constraints).
+		bool position_based;
+		/// Number of iterations over the constraints at every time step.
+		size_t pbd_iterations;
+		/**
+		 * @brief Colours of the springs.
+		 *
+		 * The springs in @ref springs are sorted by colour: the springs
+		 * of the @e c-th colour are those in the interval
+		 * [@e spring_colours[c], @e spring_colours[c + 1]). No two springs
+		 * of the same colour share a particle (see @ref colour_springs).
+		 * Empty when the springs have not been coloured yet.
+		 */
+		std::vector<size_t> spring_colours;
+		/// Lagrange multiplier of every spring's constraint.
+		std::vector<float> pbd_lambda;
+
+	protected:
+
+		/**
+		 * @brief Makes the list of springs of the mesh.
+		 *
+		 * Fills @ref springs with the springs whose forces are
+		 * computed in @ref update_forces, that is, those of the
+		 * internal forces being simulated.
+		 *
+		 * By default, the mesh has no springs, so its implicit
+		 * integration only takes into account the forces of the
+		 * particles, and its particles are not constrained in
+		 * position-based dynamics.
+		 */
+		virtual void make_springs();
+
+		/**
+		 * @brief Makes the list of springs only if it is not up to date.
+		 *
+		 * Calls @ref make_springs the first time it is called after
+		 * @ref invalidate_springs, and also @ref colour_springs the
+		 * first time it is called with @e colour set to true.
+		 * @param colour Are the springs needed sorted by colour?
+		 */
+		void update_springs(bool colour = false);
+		/**
+		 * @brief Marks the springs of the mesh as outdated.
+		 *
+		 * Must be called whenever the springs of the mesh change,
+		 * i.e., when its particles, its rest lengths or the internal
+		 * forces being simulated change. Also invalidates the stable
+		 * time step (see @ref compute_stable_time_step).
+		 */
+		void invalidate_springs();
+
+		/**
+		 * @brief Colours the springs of the mesh.
+		 *
+		 * Assigns colours to the springs in @ref springs so that no
+		 * two springs with a common particle have the same colour,
+		 * with a greedy colouring, and sorts them by colour (see
+		 * @ref spring_colours).
+		 */
+		void colour_springs();
+
+		/// Computes q = A*d, where A is the system's matrix.
+		void multiply_system
+		(const std::vector<math::vec3>& d, std::vector<math::vec3>& q) const;
+
 	public:
 		/// Default constructor.
 		mesh();
@@ -185,6 +311,87 @@ class mesh {
 		 * acting on the particles due to force fields.
 		 */
 		virtual void update_forces() = 0;
+		/**
+		 * @brief Update the forces generated within the mesh.
+		 *
+		 * Same as @ref update_forces(), but multithreaded. By default,
+		 * calls @ref update_forces().
+		 * @param n Number of threads.
+		 */
+		virtual void update_forces(size_t n);
+
+		/**
+		 * @brief Solves a step of implicit (backward) Euler.
+		 *
+		 * Computes the change of velocity \f$\Delta v\f$ of every particle
+		 * in a time step of length @e dt (Baraff and Witkin [1]), solving
+		 \f[
+		 \left(M - dt \frac{\partial f}{\partial v} - dt^2 \frac{\partial f}{\partial x}\right) \Delta v =
+		 dt \left(f + dt \frac{\partial f}{\partial x} v\right)
+		 \f]
+		 * with the conjugate gradient method, preconditioned with the
+		 * diagonal of the matrix. The Jacobians are those of the springs
+		 * in @ref springs. The forces @e f are those of the particles,
+		 * which include the forces of the springs and any external force.
+		 *
+		 * The next velocity of a particle is then \f$v + \Delta v\f$ and
+		 * its next position is \f$x + dt (v + \Delta v)\f$. Fixed particles
+		 * do not change their velocity.
+		 *
+		 * [1] Large steps in cloth simulation.
+		 *     David Baraff, Andrew Witkin.
+		 *     SIGGRAPH 1998.
+		 * @param dt Time step.
+		 * @param[out] dv Change of velocity of every particle.
+		 * @pre The forces of the particles have been computed.
+		 */
+		void solve_implicit(float dt, math::vec3 *dv);
+
+		/**
+		 * @brief Projects the predicted positions onto the constraints.
+		 *
+		 * Every spring in @ref springs is a distance constraint between
+		 * its two particles, with the spring's rest length. Constraints
+		 * are solved with extended position-based dynamics (Macklin et
+		 * al. [1]), with compliance \f$1/K_e\f$ and damping \f$K_d\f$,
+		 * in @ref pbd_iterations Gauss-Seidel iterations. Springs are
+		 * coloured (see @ref colour_springs) so that the constraints of
+		 * the same colour are solved in parallel.
+		 *
+		 * The next velocity of a particle is then the difference between
+		 * its position in @e x and its current position divided by @e dt.
+		 * Fixed particles do not move.
+		 *
+		 * [1] XPBD: Position-Based Simulation of Compliant Constrained Dynamics.
+		 *     Miles Macklin, Matthias Müller, Nuttapong Chentanez.
+		 *     Motion in Games 2016.
+		 * @param dt Time step.
+		 * @param[in,out] x Predicted position of every particle, moved
+		 * only by the forces of the particles.
+		 * @param n Number of threads.
+		 */
+		void solve_constraints(float dt, math::vec3 *x, size_t n = 1);
+
+		/**
+		 * @brief Computes the largest stable time step.
+		 *
+		 * Largest time step for which the explicit integration of the
+		 * springs of the mesh (see @ref springs) is stable, that is,
+		 * \f$2/\omega\f$ where \f$\omega\f$ is an upper bound of the
+		 * largest natural frequency of the springs:
+		 * \f$\omega^2 = \max_i 2 k_i K_e / m_i\f$, where \f$k_i\f$ is the
+		 * number of springs of the @e i-th particle and \f$m_i\f$ its mass.
+		 * Fixed particles are not taken into account.
+		 *
+		 * The value is cached, and is computed again only after the
+		 * springs (see @ref invalidate_springs), the elasticity
+		 * coefficient or the mass of the mesh change. Changing the mass
+		 * of the particles, or whether they are fixed, directly on the
+		 * particles (see @ref get_particles) does not update it.
+		 * @returns Returns the largest stable time step, or the largest
+		 * floating-point value if the mesh has no springs.
+		 */
+		float compute_stable_time_step();
 
 		// SETTERS
 
@@ -207,6 +414,36 @@ class mesh {
 		 */
 		void set_mass(float Kg);
 
+		/**
+		 * @brief Sets whether this mesh is integrated implicitly.
+		 *
+		 * When it is, the solver of the simulator is not used on
+		 * the particles of this mesh: they are moved with implicit
+		 * Euler instead (see @ref solve_implicit).
+		 * @param i Integrate implicitly.
+		 */
+		void set_implicit(bool i);
+		/// Sets the maximum number of iterations of the conjugate gradient.
+		void set_cg_iterations(size_t it);
+		/// Sets the relative tolerance of the conjugate gradient's residual.
+		void set_cg_tolerance(float tol);
+
+		/**
+		 * @brief Sets whether this mesh is simulated with position-based
+		 * dynamics.
+		 *
+		 * When it is, the solver of the simulator is not used on the
+		 * particles of this mesh, and the internal forces of the mesh
+		 * are replaced by constraints (see @ref solve_constraints).
+		 * A mesh can not be integrated implicitly and be simulated
+		 * with position-based dynamics at the same time: setting one
+		 * of the two modes deactivates the other.
+		 * @param p Use position-based dynamics.
+		 */
+		void set_position_based(bool p);
+		/// Sets the number of iterations over the constraints.
+		void set_pbd_iterations(size_t it);
+
 		// GETTERS
 
 		/// Returns the elasticity coefficient of this mesh.
@@ -222,6 +459,17 @@ class mesh {
 		/// Returns the number of particles of this mesh.
 		size_t size() const;
 
+		/// Returns whether this mesh is integrated implicitly.
+		bool is_implicit() const;
+		/// Returns the maximum number of iterations of the conjugate gradient.
+		size_t get_cg_iterations() const;
+		/// Returns the relative tolerance of the conjugate gradient's residual.
+		float get_cg_tolerance() const;
+		/// Returns whether this mesh is simulated with position-based dynamics.
+		bool is_position_based() const;
+		/// Returns the number of iterations over the constraints.
+		size_t get_pbd_iterations() const;
+
 		/// Returns the type of this mesh. See @ref mt.
 		const mesh_type& get_type() const;
 
@@ -67,6 +67,25 @@ namespace meshes {
 	__pm3_invert(F1_m1, F1_m1);											\
 	__pm3_add_acc_v(ps[j].force, F1_m1)
 
+// PROTECTED
+
+void mesh1d::make_springs() {
+	assert(ds != nullptr);
+
+	springs.clear();
+	for (size_t i = 0; i < N - 2; ++i) {
+		if (stretch) {
+			springs.push_back(spring{i, i + 1, ds[i].x});
+		}
+		if (bend) {
+			springs.push_back(spring{i, i + 2, ds[i].y});
+		}
+	}
+	if (stretch) {
+		springs.push_back(spring{N - 2, N - 1, ds[N - 2].x});
+	}
+}
+
 // PUBLIC
 
 mesh1d::mesh1d() : mesh() {
@@ -99,6 +118,8 @@ void mesh1d::make_initial_state() {
 		ds[i].y = __pm3_dist(ps[i].cur_pos, ps[i + 2].cur_pos);
 	}
 	ds[N - 2].x = __pm3_dist(ps[N - 2].cur_pos, ps[N - 1].cur_pos);
+
+	invalidate_springs();
 }
 
 void mesh1d::update_forces() {
@@ -136,10 +157,12 @@ void mesh1d::clear() {
 
 void mesh1d::simulate_stretch(bool s) {
 	stretch = s;
+	invalidate_springs();
 }
 
 void mesh1d::simulate_bend(bool s) {
 	bend = s;
+	invalidate_springs();
 }
 
 // GETTERS
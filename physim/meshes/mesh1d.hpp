@@ -86,6 +86,15 @@ class mesh1d : public mesh {
 		/// Simulate bend forces.
 		bool bend;
 
+	protected:
+
+		/**
+		 * @brief Makes the list of springs of the mesh.
+		 *
+		 * See @ref mesh::make_springs.
+		 */
+		void make_springs();
+
 	public:
 		/// Default constructor.
 		mesh1d();
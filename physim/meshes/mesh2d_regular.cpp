@@ -70,6 +70,49 @@ namespace meshes {
 	__pm3_invert(F1_m1, F1_m1);											\
 	__pm3_add_acc_v(ps[j].force, F1_m1)
 
+// PROTECTED
+
+void mesh2d_regular::make_springs() {
+	assert(sb_ds != nullptr);
+
+	// the same springs as in update_forces
+	springs.clear();
+	for (size_t i = 0; i < R; ++i) {
+		for (size_t j = 0; j < C; ++j) {
+			const vec6& d = sb_ds[idx(i,j)];
+
+			if (stretch) {
+				if (j + 1 < C) {
+					springs.push_back(spring{idx(i,j), idx(i,j + 1), d.x});
+				}
+				if (i + 1 < R) {
+					springs.push_back(spring{idx(i,j), idx(i + 1,j), d.y});
+				}
+			}
+
+			if (bend) {
+				if (j + 2 < C) {
+					springs.push_back(spring{idx(i,j), idx(i,j + 2), d.z});
+				}
+				if (i + 2 < R) {
+					springs.push_back(spring{idx(i,j), idx(i + 2,j), d.u});
+				}
+			}
+
+			if (shear) {
+				if (j + 1 < C) {
+					if (i > 0) {
+						springs.push_back(spring{idx(i,j), idx(i - 1,j + 1), d.v});
+					}
+					if (i + 1 < R) {
+						springs.push_back(spring{idx(i,j), idx(i + 1,j + 1), d.w});
+					}
+				}
+			}
+		}
+	}
+}
+
 // PUBLIC
 
 mesh2d_regular::mesh2d_regular() : mesh() {
@@ -141,6 +184,8 @@ void mesh2d_regular::make_initial_state() {
 			}
 		}
 	}
+
+	invalidate_springs();
 }
 
 void mesh2d_regular::update_forces() {
@@ -342,6 +387,75 @@ void mesh2d_regular::update_forces() {
 	*/
 }
 
+void mesh2d_regular::update_forces(size_t n) {
+	assert(sb_ds != nullptr);
+
+	if (n == 1) {
+		update_forces();
+		return;
+	}
+
+	// 1. springs within a row: stretch and bend
+	if (stretch or bend) {
+		#pragma omp parallel for num_threads(n)
+		for (size_t i = 0; i < R; ++i) {
+			vec3 F1_m1, dir, dvel;
+			float dist;
+
+			for (size_t j = 0; j < C; ++j) {
+				if (stretch and j + 1 < C) {
+					compute_forces( idx(i,j), idx(i,j + 1), sb_ds[idx(i,j)].x );
+				}
+				if (bend and j + 2 < C) {
+					compute_forces( idx(i,j), idx(i,j + 2), sb_ds[idx(i,j)].z );
+				}
+			}
+		}
+	}
+
+	// 2. springs between rows i and i + 1: stretch and shear.
+	// First the even values of i, then the odd ones.
+	if ((stretch or shear) and R > 1) {
+		for (size_t parity = 0; parity < 2; ++parity) {
+			#pragma omp parallel for num_threads(n)
+			for (size_t i = parity; i < R - 1; i += 2) {
+				vec3 F1_m1, dir, dvel;
+				float dist;
+
+				for (size_t j = 0; j < C; ++j) {
+					if (stretch) {
+						compute_forces( idx(i,j), idx(i + 1,j), sb_ds[idx(i,j)].y );
+					}
+					if (shear and j + 1 < C) {
+						compute_forces( idx(i,j), idx(i + 1,j + 1), sb_ds[idx(i,j)].w );
+						compute_forces( idx(i + 1,j), idx(i,j + 1), sb_ds[idx(i + 1,j)].v );
+					}
+				}
+			}
+		}
+	}
+
+	// 3. springs between rows i and i + 2: bend.
+	// First the values of i with i/2 even, then the others.
+	if (bend and R > 2) {
+		for (size_t parity = 0; parity < 2; ++parity) {
+			#pragma omp parallel for num_threads(n)
+			for (size_t i = 0; i < R - 2; ++i) {
+				if ((i/2)%2 != parity) {
+					continue;
+				}
+
+				vec3 F1_m1, dir, dvel;
+				float dist;
+
+				for (size_t j = 0; j < C; ++j) {
+					compute_forces( idx(i,j), idx(i + 2,j), sb_ds[idx(i,j)].u );
+				}
+			}
+		}
+	}
+}
+
 void mesh2d_regular::clear() {
 	mesh::clear();
 
@@ -360,18 +474,22 @@ void mesh2d_regular::set_dimensions(size_t r, size_t c) {
 
 	R = r;
 	C = c;
+	invalidate_springs();
 }
 
 void mesh2d_regular::simulate_stretch(bool s) {
 	stretch = s;
+	invalidate_springs();
 }
 
 void mesh2d_regular::simulate_shear(bool s) {
 	shear = s;
+	invalidate_springs();
 }
 
 void mesh2d_regular::simulate_bend(bool s) {
 	bend = s;
+	invalidate_springs();
 }
 
 // GETTERS
@@ -111,6 +111,15 @@ class mesh2d_regular : public mesh {
 		/// Simulate bend forces.
 		bool bend;
 
+	protected:
+
+		/**
+		 * @brief Makes the list of springs of the mesh.
+		 *
+		 * See @ref mesh::make_springs.
+		 */
+		void make_springs();
+
 	public:
 		/// Default constructor.
 		mesh2d_regular();
@@ -149,6 +158,18 @@ class mesh2d_regular : public mesh {
 		 * of the mesh must have been made (see @ref make_initial_state).
 		 */
 		void update_forces();
+		/**
+		 * @brief Update the forces generated within the mesh.
+		 *
+		 * Same as @ref update_forces(), but multithreaded. The springs
+		 * are split in classes such that the springs of a class have
+		 * no particle in common: horizontal springs, by row; springs
+		 * between rows @e i and @e i + 1 by the parity of @e i; bend
+		 * springs between rows @e i and @e i + 2 by the parity of
+		 * @e i/2. The springs of a class are evaluated in parallel.
+		 * @param n Number of threads.
+		 */
+		void update_forces(size_t n);
 
 		void clear();
 
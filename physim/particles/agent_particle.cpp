@@ -33,6 +33,8 @@ using namespace std;
 
 #define FULL_MASK static_cast<int>(0xffffffff)
 #define ninety static_cast<float>(M_PI)/2.0f
+#define cosangle3d(u,v) __pm3_dot(u,v)/(__pm3_norm(u)*__pm3_norm(v))
+#define angle3d(u,v) std::acos(cosangle3d(u,v))
 
 namespace physim {
 using namespace math;
@@ -67,6 +69,152 @@ void agent_particle::partial_init() {
 	wow_distance = 5.0f;
 }
 
+// PROTECTED
+
+void agent_particle::add_collision_avoidance
+(const geometry *g, vec3& v) const
+{
+	// skip distant objects
+	vec3 geom_pos = g->get_box_center();
+	float dist2;
+	if (g->get_geom_type() == geometry_type::Rectangle) {
+		// consider distance to object
+		const rectangle *r = static_cast<const rectangle *>(g);
+		dist2 = r->distance(cur_pos);
+		dist2 = dist2*dist2;
+	}
+	else if (g->get_geom_type() == geometry_type::Plane) {
+		// consider distance to object
+		const plane *p = static_cast<const plane *>(g);
+		dist2 = p->dist_point_plane(cur_pos);
+		dist2 = dist2*dist2;
+	}
+	else {
+		dist2 = __pm3_dist2(cur_pos, geom_pos) - g->approx_radius();
+	}
+	if (dist2 > coll_distance*coll_distance) {
+		return;
+	}
+
+	bool skip = false;
+
+	// decide, using a second criteria, whether
+	// this geometry should be skipped or not
+	vec3 repulsion;
+	if (g->get_geom_type() == geometry_type::Rectangle) {
+		// this is a wall
+		const plane& p = static_cast<const rectangle *>(g)->get_plane();
+		__pm3_assign_v(repulsion, p.get_normal());
+		if (p.dist_point_plane(cur_pos) < 0.0f) {
+			__pm3_invert(repulsion, repulsion);
+		}
+		float angle = __pm3_angle(repulsion, cur_vel);
+		if (angle < 1.571f) {
+			// the '< 1.571' is counterintuitive, but just
+			// do a little drawing and you will know why
+			skip = true;
+		}
+	}
+	else if (g->get_geom_type() == geometry_type::Plane) {
+		// this is a wall
+		const plane *p = static_cast<const plane *>(g);
+		__pm3_assign_v(repulsion, p->get_normal());
+		if (p->dist_point_plane(cur_pos) < 0.0f) {
+			__pm3_invert(repulsion, repulsion);
+		}
+		float angle = __pm3_angle(repulsion, cur_vel);
+		if (angle < 1.571f) {
+			// the '< 1.571' is counterintuitive, but just
+			// do a little drawing and you will know why
+			skip = true;
+		}
+	}
+	else {
+		// project 'geom_pos' onto line through current
+		// position and director vector current velocity
+		vec3 agent_to_object = geom_pos - cur_pos;
+		float angle = __pm3_angle(agent_to_object, cur_vel);
+		if (angle > 1.571f) {
+			skip = true;
+		}
+
+		// use cross products to obtain repulsion vector
+		// (only if not skip)
+		if (not skip) {
+			vec3 c;
+			__pm3_cross(c, cur_vel, agent_to_object);
+			__pm3_cross(repulsion, cur_vel, c);
+			normalise(repulsion, repulsion);
+		}
+	}
+
+	if (skip) {
+		return;
+	}
+
+	// compute contribution
+	__pm3_add_acc_vs(v, repulsion, coll_weight);
+}
+
+void agent_particle::add_unaligned_collision_avoidance
+(const agent_particle& a, vec3& v) const
+{
+	if (index == a.index) {
+		return;
+	}
+	float D = __pm3_dist(cur_pos, a.cur_pos);
+	if (D - (R + a.R) > ucoll_distance) {
+		return;
+	}
+
+	vec3 future_agent;
+	__pm3_add_v_vs(future_agent, a.cur_pos, a.cur_vel, 0.01f);
+	vec3 A_to_future;
+	__pm3_sub_v_v(A_to_future, future_agent, cur_pos);
+	float pred_angle = angle3d(cur_vel, A_to_future);
+	if (pred_angle > ninety) {
+		return;
+	}
+
+	// vector from this agent to the other agent
+	vec3 AB;
+	__pm3_sub_v_v(AB, a.cur_pos, cur_pos);
+	float vta_angle = angle3d(AB, cur_vel);
+	if (vta_angle > ninety) {
+		return;
+	}
+
+	// compute repulsion using vector from this position
+	// to the agent's position and this velocity
+	vec3 X, pos_rep;
+	__pm3_cross(X, AB, cur_vel);
+	__pm3_cross(pos_rep, X,cur_vel);
+
+	// Do not normalise! The greater the velocity
+	// the greater the force.
+	__pm3_add_acc_vs(v, pos_rep, ucoll_weight);
+}
+
+void agent_particle::add_wwm(const agent_particle& a, vec3& v) const {
+	if (index == a.index) {
+		return;
+	}
+	float D = __pm3_dist(cur_pos, a.cur_pos);
+	if (D - (R + a.R) > wow_distance) {
+		return;
+	}
+
+	// compute repulsion using vector from this position
+	// to the agent's position and this velocity
+	vec3 X, pos_rep;
+	__pm3_cross(X, cur_vel, a.cur_vel);
+	__pm3_cross(pos_rep, X,cur_vel);
+
+	// Do not normalise! The greater the velocity
+	// the greater the force.
+	__pm3_add_acc_vs(v, pos_rep, wow_weight);
+}
+
 // PUBLIC
 
 agent_particle::agent_particle() {
@@ -116,6 +264,23 @@ bool agent_particle::is_behaviour_set(const agent_behaviour_type& b) const {
 	return k != 0;
 }
 
+bool agent_particle::needs_neighbours() const {
+	return
+		is_behaviour_set(agent_behaviour_type::unaligned_collision_avoidance) or
+		is_behaviour_set(agent_behaviour_type::walk_with_me);
+}
+
+float agent_particle::get_neighbourhood_distance() const {
+	float d = 0.0f;
+	if (is_behaviour_set(agent_behaviour_type::unaligned_collision_avoidance)) {
+		d = std::max(d, ucoll_distance + R);
+	}
+	if (is_behaviour_set(agent_behaviour_type::walk_with_me)) {
+		d = std::max(d, wow_distance + R);
+	}
+	return d;
+}
+
 // SETTERS
 
 void agent_particle::set_behaviour(const agent_behaviour_type& b) {
@@ -171,6 +336,23 @@ const
 	}
 }
 
+void agent_particle::apply_behaviours
+(const vector<geometry *>& scene, const vector<size_t>& obstacles,
+ vec3& weighted_steering)
+const
+{
+	if (behaviour == agent_behaviour_type::none) {
+		return;
+	}
+
+	vec3 v;
+
+	if (is_behaviour_set(agent_behaviour_type::collision_avoidance)) {
+		collision_avoidance_behaviour(scene, obstacles, v);
+		__pm3_add_acc_v(weighted_steering, v);
+	}
+}
+
 void agent_particle::apply_behaviours
 (const std::vector<agent_particle>& agents, vec3& weighted_steering)
 const
@@ -192,6 +374,28 @@ const
 	}
 }
 
+void agent_particle::apply_behaviours
+(const vector<agent_particle>& agents, const vector<size_t>& neighs,
+ vec3& weighted_steering)
+const
+{
+	if (behaviour == agent_behaviour_type::none) {
+		return;
+	}
+
+	vec3 v;
+
+	if (is_behaviour_set(agent_behaviour_type::unaligned_collision_avoidance)) {
+		unaligned_collision_avoidance_behaviour(agents, neighs, v);
+		__pm3_add_acc_v(weighted_steering, v);
+	}
+
+	if (is_behaviour_set(agent_behaviour_type::walk_with_me)) {
+		wwm_behaviour(agents, neighs, v);
+		__pm3_add_acc_v(weighted_steering, v);
+	}
+}
+
 /* steering behaviours */
 
 void agent_particle::seek_behaviour(vec3& v) const {
@@ -246,164 +450,55 @@ const
 {
 	__pm3_assign_s(v, 0.0f);
 	for (const geometry *g : scene) {
-		// skip distant objects
-		vec3 geom_pos = g->get_box_center();
-		float dist2;
-		if (g->get_geom_type() == geometry_type::Rectangle) {
-			// consider distance to object
-			const rectangle *r = static_cast<const rectangle *>(g);
-			dist2 = r->distance(cur_pos);
-			dist2 = dist2*dist2;
-		}
-		else if (g->get_geom_type() == geometry_type::Plane) {
-			// consider distance to object
-			const plane *p = static_cast<const plane *>(g);
-			dist2 = p->dist_point_plane(cur_pos);
-			dist2 = dist2*dist2;
-		}
-		else {
-			dist2 = __pm3_dist2(cur_pos, geom_pos) - g->approx_radius();
-		}
-		if (dist2 > coll_distance*coll_distance) {
-			continue;
-		}
-
-		bool skip = false;
-
-		// decide, using a second criteria, whether
-		// this geometry should be skipped or not
-		vec3 repulsion;
-		if (g->get_geom_type() == geometry_type::Rectangle) {
-			// this is a wall
-			const plane& p = static_cast<const rectangle *>(g)->get_plane();
-			__pm3_assign_v(repulsion, p.get_normal());
-			if (p.dist_point_plane(cur_pos) < 0.0f) {
-				__pm3_invert(repulsion, repulsion);
-			}
-			float angle = __pm3_angle(repulsion, cur_vel);
-			if (angle < 1.571f) {
-				// the '< 1.571' is counterintuitive, but just
-				// do a little drawing and you will know why
-				skip = true;
-			}
-		}
-		else if (g->get_geom_type() == geometry_type::Plane) {
-			// this is a wall
-			const plane *p = static_cast<const plane *>(g);
-			__pm3_assign_v(repulsion, p->get_normal());
-			if (p->dist_point_plane(cur_pos) < 0.0f) {
-				__pm3_invert(repulsion, repulsion);
-			}
-			float angle = __pm3_angle(repulsion, cur_vel);
-			if (angle < 1.571f) {
-				// the '< 1.571' is counterintuitive, but just
-				// do a little drawing and you will know why
-				skip = true;
-			}
-		}
-		else {
-			// project 'geom_pos' onto line through current
-			// position and director vector current velocity
-			vec3 agent_to_object = geom_pos - cur_pos;
-			float angle = __pm3_angle(agent_to_object, cur_vel);
-			if (angle > 1.571f) {
-				skip = true;
-			}
-
-			// use cross products to obtain repulsion vector
-			// (only if not skip)
-			if (not skip) {
-				vec3 c;
-				__pm3_cross(c, cur_vel, agent_to_object);
-				__pm3_cross(repulsion, cur_vel, c);
-				normalise(repulsion, repulsion);
-			}
-		}
-
-		if (skip) {
-			continue;
-		}
-
-		// compute contribution
-		__pm3_add_acc_vs(v, repulsion, coll_weight);
+		add_collision_avoidance(g, v);
 	}
 }
 
-#define cosangle3d(u,v) __pm3_dot(u,v)/(__pm3_norm(u)*__pm3_norm(v))
-#define angle3d(u,v) std::acos(cosangle3d(u,v))
+void agent_particle::collision_avoidance_behaviour
+(const vector<geometry *>& scene, const vector<size_t>& obstacles, vec3& v)
+const
+{
+	__pm3_assign_s(v, 0.0f);
+	for (size_t k : obstacles) {
+		add_collision_avoidance(scene[k], v);
+	}
+}
 
 void agent_particle::unaligned_collision_avoidance_behaviour
 (const vector<agent_particle>& agents, vec3& v) const
 {
-	vec3 X;
-	vec3 pos_rep, vel_rep;
-
 	__pm3_assign_s(v, 0.0f);
-	float r = ucoll_distance;
-
 	for (const agent_particle& a : agents) {
-		if (index == a.index) {
-			continue;
-		}
-		float D = __pm3_dist(cur_pos, a.cur_pos);
-		if (D - (R + a.R) > r) {
-			continue;
-		}
-
-		vec3 future_agent;
-		__pm3_add_v_vs(future_agent, a.cur_pos, a.cur_vel, 0.01f);
-		vec3 A_to_future;
-		__pm3_sub_v_v(A_to_future, future_agent, cur_pos);
-		float pred_angle = angle3d(cur_vel, A_to_future);
-		if (pred_angle > ninety) {
-			continue;
-		}
-
-		// vector from this agent to the other agent
-		vec3 AB;
-		__pm3_sub_v_v(AB, a.cur_pos, cur_pos);
-		float vta_angle = angle3d(AB, cur_vel);
-		if (vta_angle > ninety) {
-			continue;
-		}
-
-		// compute repulsion using vector from this position
-		// to the agent's position and this velocity
-		__pm3_cross(X, AB, cur_vel);
-		__pm3_cross(pos_rep, X,cur_vel);
+		add_unaligned_collision_avoidance(a, v);
+	}
+}
 
-		// Do not normalise! The greater the velocity
-		// the greater the force.
-		__pm3_add_acc_vs(v, pos_rep, ucoll_weight);
+void agent_particle::unaligned_collision_avoidance_behaviour
+(const vector<agent_particle>& agents, const vector<size_t>& neighs, vec3& v)
+const
+{
+	__pm3_assign_s(v, 0.0f);
+	for (size_t j : neighs) {
+		add_unaligned_collision_avoidance(agents[j], v);
 	}
 }
 
 void agent_particle::wwm_behaviour
 (const std::vector<agent_particle>& agents, math::vec3& v) const
 {
-	vec3 X;
-	vec3 pos_rep, vel_rep;
-
 	__pm3_assign_s(v, 0.0f);
-	float r = wow_distance;
-
 	for (const agent_particle& a : agents) {
-		if (index == a.index) {
-			continue;
-		}
-		float D = __pm3_dist(cur_pos, a.cur_pos);
-		if (D - (R + a.R) > r) {
-			continue;
-		}
-
-		// compute repulsion using vector from this position
-		// to the agent's position and this velocity
-		__pm3_cross(X, cur_vel, a.cur_vel);
-		__pm3_cross(pos_rep, X,cur_vel);
+		add_wwm(a, v);
+	}
+}
 
-		// Do not normalise! The greater the velocity
-		// the greater the force.
-		__pm3_add_acc_vs(v, pos_rep, wow_weight);
+void agent_particle::wwm_behaviour
+(const vector<agent_particle>& agents, const vector<size_t>& neighs, vec3& v)
+const
+{
+	__pm3_assign_s(v, 0.0f);
+	for (size_t j : neighs) {
+		add_wwm(agents[j], v);
 	}
 }
 
@@ -144,6 +144,36 @@ class agent_particle : public sized_particle {
 		 */
 		void partial_init();
 
+	protected:
+		/**
+		 * @brief Adds the collision avoidance steering force due to
+		 * geometrical object @e g.
+		 *
+		 * See @ref collision_avoidance_behaviour.
+		 * @param[in] g A geometrical object.
+		 * @param[out] v Collision avoidance steering vector.
+		 */
+		void add_collision_avoidance
+		(const geometric::geometry *g, math::vec3& v) const;
+		/**
+		 * @brief Adds the unaligned collision avoidance steering force
+		 * due to agent @e a.
+		 *
+		 * See @ref unaligned_collision_avoidance_behaviour.
+		 * @param[in] a Another agent.
+		 * @param[out] v Unaligned collision avoidance steering vector.
+		 */
+		void add_unaligned_collision_avoidance
+		(const agent_particle& a, math::vec3& v) const;
+		/**
+		 * @brief Adds the "walk off with" steering force due to agent @e a.
+		 *
+		 * See @ref wwm_behaviour.
+		 * @param[in] a Another agent.
+		 * @param[out] v "Walk off with" steering vector.
+		 */
+		void add_wwm(const agent_particle& a, math::vec3& v) const;
+
 	public:
 		/**
 		 * @brief Target position of this particle.
@@ -243,6 +273,25 @@ class agent_particle : public sized_particle {
 		/// Returns whether behaviour @e b is activated or not.
 		bool is_behaviour_set(const agent_behaviour_type& b) const;
 
+		/**
+		 * @brief Returns whether some behaviour depends on other agents.
+		 *
+		 * These are @ref agent_behaviour_type::unaligned_collision_avoidance
+		 * and @ref agent_behaviour_type::walk_with_me.
+		 */
+		bool needs_neighbours() const;
+		/**
+		 * @brief Returns the largest distance at which this agent is
+		 * affected by another agent.
+		 *
+		 * The distance between the agents considered is the distance
+		 * between their current positions minus the radius of the other
+		 * agent (see @ref unaligned_collision_avoidance_behaviour and
+		 * @ref wwm_behaviour). It is 0 if no behaviour depends on other
+		 * agents (see @ref needs_neighbours).
+		 */
+		float get_neighbourhood_distance() const;
+
 		// SETTERS
 
 		/**
@@ -322,6 +371,21 @@ class agent_particle : public sized_particle {
 		void apply_behaviours
 		(const std::vector<geometric::geometry *>& scene,
 		 math::vec3& weighted_steering) const;
+		/**
+		 * @brief Computes a weighted steering vector force.
+		 *
+		 * Same as @ref apply_behaviours(const std::vector<geometric::geometry *>&, math::vec3&)const
+		 * but only the objects in @e obstacles are considered.
+		 * @param[in] scene The geometry in the simulation.
+		 * @param[in] obstacles Indices of the objects near this agent, in
+		 * increasing order. Must contain all objects within distance
+		 * @ref coll_distance (see @ref structures::obstacle_grid).
+		 * @param[out] weighted_steering Weighted steering vector.
+		 */
+		void apply_behaviours
+		(const std::vector<geometric::geometry *>& scene,
+		 const std::vector<size_t>& obstacles,
+		 math::vec3& weighted_steering) const;
 
 		/**
 		 * @brief Computes a weighted steering vector force.
@@ -344,6 +408,22 @@ class agent_particle : public sized_particle {
 		void apply_behaviours
 		(const std::vector<agent_particle>& agents,
 		 math::vec3& weighted_steering) const;
+		/**
+		 * @brief Computes a weighted steering vector force.
+		 *
+		 * Same as @ref apply_behaviours(const std::vector<agent_particle>&, math::vec3&)const
+		 * but only the agents in @e neighs are considered.
+		 *
+		 * Recall that the index of this agent particle is stored in @ref index.
+		 * @param[in] agents All the agents in the simulation.
+		 * @param[in] neighs Indices of the agents near this agent. Must
+		 * contain all agents within distance @ref get_neighbourhood_distance.
+		 * @param[out] weighted_steering Weighted steering vector.
+		 */
+		void apply_behaviours
+		(const std::vector<agent_particle>& agents,
+		 const std::vector<size_t>& neighs,
+		 math::vec3& weighted_steering) const;
 
 		/* steering behaviours */
 
@@ -395,6 +475,20 @@ class agent_particle : public sized_particle {
 		 */
 		virtual void collision_avoidance_behaviour
 		(const std::vector<geometric::geometry *>& scene, math::vec3& v) const;
+		/**
+		 * @brief Computes the collision avoidance steering force.
+		 *
+		 * Same as @ref collision_avoidance_behaviour
+		 * (const std::vector<geometric::geometry *>&, math::vec3&)const
+		 * but only the objects in @e obstacles are considered.
+		 * @param[in] scene The geometry in the simulation.
+		 * @param[in] obstacles Indices of the objects near this agent.
+		 * @param[out] v Collision avoidance steering vector.
+		 * @pre Vector @e v may not be initialised to 0.
+		 */
+		virtual void collision_avoidance_behaviour
+		(const std::vector<geometric::geometry *>& scene,
+		 const std::vector<size_t>& obstacles, math::vec3& v) const;
 		/**
 		 * @brief Computes the collision avoidance steering force.
 		 *
@@ -423,6 +517,20 @@ class agent_particle : public sized_particle {
 		 */
 		virtual void unaligned_collision_avoidance_behaviour
 		(const std::vector<agent_particle>& agents, math::vec3& v) const;
+		/**
+		 * @brief Computes the collision avoidance steering force.
+		 *
+		 * Same as @ref unaligned_collision_avoidance_behaviour
+		 * (const std::vector<agent_particle>&, math::vec3&)const
+		 * but only the agents in @e neighs are considered.
+		 * @param[in] agents All the agents in the simulation.
+		 * @param[in] neighs Indices of the agents near this agent.
+		 * @param[out] v Unaligned collision avoidance steering vector.
+		 * @pre Vector @e v may not be initialised to 0.
+		 */
+		virtual void unaligned_collision_avoidance_behaviour
+		(const std::vector<agent_particle>& agents,
+		 const std::vector<size_t>& neighs, math::vec3& v) const;
 		/**
 		 * @brief Computes the "walk off with" steering force.
 		 *
@@ -450,6 +558,20 @@ class agent_particle : public sized_particle {
 		 */
 		virtual void wwm_behaviour
 		(const std::vector<agent_particle>& agents, math::vec3& v) const;
+		/**
+		 * @brief Computes the "walk off with" steering force.
+		 *
+		 * Same as @ref wwm_behaviour
+		 * (const std::vector<agent_particle>&, math::vec3&)const
+		 * but only the agents in @e neighs are considered.
+		 * @param[in] agents All the agents in the simulation.
+		 * @param[in] neighs Indices of the agents near this agent.
+		 * @param[out] v "Walk off with" steering vector.
+		 * @pre Vector @e v may not be initialised to 0.
+		 */
+		virtual void wwm_behaviour
+		(const std::vector<agent_particle>& agents,
+		 const std::vector<size_t>& neighs, math::vec3& v) const;
 };
 
 } // -- namespace particles
@@ -47,6 +47,18 @@ base_particle::~base_particle() {
 
 }
 
+// OPERATORS
+
+base_particle& base_particle::operator= (const base_particle& p) {
+	__pm3_assign_v(prev_pos, p.prev_pos);
+	__pm3_assign_v(cur_pos, p.cur_pos);
+	__pm3_assign_v(cur_vel, p.cur_vel);
+	__pm3_assign_v(force, p.force);
+	mass = p.mass;
+	index = p.index;
+	return *this;
+}
+
 // MODIFIERS
 
 void base_particle::save_position() {
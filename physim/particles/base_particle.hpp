@@ -77,6 +77,11 @@ class base_particle {
 		/// Destructor.
 		virtual ~base_particle();
 
+		// OPERATORS
+
+		/// Copy assignment operator.
+		base_particle& operator= (const base_particle& p);
+
 		// MODIFIERS
 
 		/**
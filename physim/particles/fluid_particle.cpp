@@ -50,6 +50,15 @@ fluid_particle::fluid_particle(const fluid_particle& p) : base_particle(p) {
 
 fluid_particle::~fluid_particle() { }
 
+// OPERATORS
+
+fluid_particle& fluid_particle::operator= (const fluid_particle& p) {
+	base_particle::operator= (p);
+	density = p.density;
+	pressure = p.pressure;
+	return *this;
+}
+
 // MODIFIERS
 
 void fluid_particle::init() {
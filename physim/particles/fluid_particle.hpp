@@ -66,6 +66,11 @@ class fluid_particle : public base_particle {
 		/// Destructor.
 		virtual ~fluid_particle();
 
+		// OPERATORS
+
+		/// Copy assignment operator.
+		fluid_particle& operator= (const fluid_particle& p);
+
 		// MODIFIERS
 
 		/**
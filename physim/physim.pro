@@ -35,6 +35,7 @@ HEADERS += \
     fields/magnetic_B.hpp \
     fields/gravitational.hpp \
     fields/gravitational_planet.hpp \
+    fields/gravitational_nbody.hpp \
     meshes/mesh.hpp \
     meshes/mesh1d.hpp \
     meshes/mesh2d.hpp \
@@ -72,6 +73,9 @@ HEADERS += \
     math/private/math3/comparison.hpp \
     particles/agent_particle.hpp \
     structures/octree.hpp \
+    structures/hash_grid.hpp \
+    structures/bvh.hpp \
+    structures/obstacle_grid.hpp \
     math/vec_templates.hpp \
     particles/fluid_particle.hpp \
     emitter/base_emitter.hpp \
@@ -86,6 +90,8 @@ HEADERS += \
     fluids/fluid.hpp \
     fluids/kernel_function.hpp \
     fluids/newtonian.hpp \
+    fluids/templated_newtonian.hpp \
+    fluids/kernels.hpp \
     math/private/numeric.hpp
 
 SOURCES += \
@@ -109,6 +115,7 @@ SOURCES += \
     fields/punctual.cpp \
     fields/gravitational.cpp \
     fields/gravitational_planet.cpp \
+    fields/gravitational_nbody.cpp \
     meshes/mesh.cpp \
     meshes/mesh1d.cpp \
     meshes/mesh2d.cpp \
@@ -122,6 +129,9 @@ SOURCES += \
     particles/agent_particle.cpp \
     sim_agent_particles.cpp \
     structures/octree.cpp \
+    structures/hash_grid.cpp \
+    structures/bvh.cpp \
+    structures/obstacle_grid.cpp \
     particles/fluid_particle.cpp \
     emitter/base_emitter.cpp \
     emitter/free_emitter.cpp \
@@ -21,6 +21,10 @@
 
 #include <physim/simulator.hpp>
 
+// C++ includes
+#include <algorithm>
+using namespace std;
+
 // physim includes
 #include <physim/math/private/math3.hpp>
 #include <physim/particles/conversions.hpp>
@@ -30,7 +34,60 @@ namespace physim {
 using namespace particles;
 using namespace math;
 
+bool simulator::make_steering_grid() {
+	float max_dist = 0.0f;
+	float max_R = 0.0f;
+	bool needed = false;
+	for (const agent_particle& p : aps) {
+		if (p.needs_neighbours()) {
+			needed = true;
+			max_dist = std::max(max_dist, p.get_neighbourhood_distance());
+		}
+		max_R = std::max(max_R, p.R);
+	}
+
+	if (not needed) {
+		steer_grid.reset();
+		return false;
+	}
+
+	float cell = max_dist + max_R;
+	if (cell <= 0.0f) {
+		cell = 1.0f;
+	}
+	steer_grid.init(&aps[0].cur_pos, aps.size(), sizeof(agent_particle), cell);
+	return true;
+}
+
+bool simulator::make_obstacle_grid() {
+	if (scene_fixed.size() == 0) {
+		return false;
+	}
+
+	float max_dist = -1.0f;
+	for (const agent_particle& p : aps) {
+		if (p.is_behaviour_set(agent_behaviour_type::collision_avoidance)) {
+			max_dist = std::max(max_dist, p.coll_distance);
+		}
+	}
+
+	if (max_dist < 0.0f) {
+		return false;
+	}
+
+	// the geometry is fixed: the grid is
+	// valid until the distance changes
+	if (max_dist != obst_distance) {
+		obst_grid.init(scene_fixed, max_dist);
+		obst_distance = max_dist;
+	}
+	return true;
+}
+
 void simulator::_simulate_agent_particles() {
+	// agents only see the agents and obstacles nearby
+	const bool use_neighbours = make_steering_grid();
+	const bool use_obstacles = make_obstacle_grid();
 
 	// first compute forces ...
 	for (size_t i = 0; i < aps.size(); ++i) {
@@ -51,14 +108,30 @@ void simulator::_simulate_agent_particles() {
 		__pm3_assign_s(steer_force, 0.0f);
 
 		p.apply_behaviours(steer_force);
-		p.apply_behaviours(scene_fixed, steer_force);
-		p.apply_behaviours(aps, steer_force);
+		if (use_obstacles) {
+			obst_cands.clear();
+			obst_grid.get_indices(p.cur_pos, obst_cands);
+			p.apply_behaviours(scene_fixed, obst_cands, steer_force);
+		}
+		else {
+			p.apply_behaviours(scene_fixed, steer_force);
+		}
+		if (use_neighbours and p.needs_neighbours()) {
+			// in increasing order of index, as if
+			// all agents were scanned
+			steer_cands.clear();
+			steer_grid.get_indices(p.cur_pos, steer_cands);
+			sort(steer_cands.begin(), steer_cands.end());
+			p.apply_behaviours(aps, steer_cands, steer_force);
+		}
 
 		// store force
 		truncate(steer_force, p.max_force, p.force);
 	}
 
 	// ... then update velocities and positions
+	vector<char> moved(aps.size(), 0);
+
 	for (size_t i = 0; i < aps.size(); ++i) {
 		agent_particle& p = aps[i];
 
@@ -106,22 +179,142 @@ void simulator::_simulate_agent_particles() {
 			__pm3_assign_v(p.cur_vel, pred_vel);
 		}
 
-		// Now it is time to perform collisions between particles.
-		// A data structure would come really in handy but, for now,
-		// a linear-time algorithm (for every particle) will be used.
+		moved[i] = 1;
+	}
 
-		if (part_part_colls_activated()) {
-			find_update_partcoll_agent(p, i);
+	// Now it is time to perform collisions between particles,
+	// once all of them have been moved.
+	if (part_part_colls_activated()) {
+		update_partcoll_agent(moved);
+	}
+
+	// compute new orientations
+	for (size_t i = 0; i < aps.size(); ++i) {
+		if (moved[i] == 0) {
+			continue;
 		}
+		agent_particle& p = aps[i];
 
-		// compute new orientation
 		vec3 alignment;
 		__pm3_sub_v_v(alignment, p.cur_vel, p.orientation);
 		normalise(alignment, alignment);
 		__pm3_add_acc_vs(p.orientation, alignment, p.align_weight);
 		normalise(p.orientation, p.orientation);
 	}
+}
+
+void simulator::_simulate_agent_particles(size_t n) {
+	// agents only see the agents and obstacles nearby
+	const bool use_neighbours = make_steering_grid();
+	const bool use_obstacles = make_obstacle_grid();
+
+	// First compute forces. The cost of each agent depends on
+	// its behaviours and on the number of agents around it: let
+	// idle threads take the remaining agents.
+	#pragma omp parallel num_threads(n)
+	{
+	// candidates of every thread
+	vector<size_t> cands, obsts;
+
+	#pragma omp for schedule(dynamic, 64)
+	for (size_t i = 0; i < aps.size(); ++i) {
+		agent_particle& p = aps[i];
+
+		// ignore fixed particles
+		if (p.fixed) {
+			continue;
+		}
+
+		// Particles age: reduce their lifetime.
+		p.reduce_lifetime(dt);
+
+		vec3 steer_force;
+		__pm3_assign_s(steer_force, 0.0f);
+
+		p.apply_behaviours(steer_force);
+		if (use_obstacles) {
+			obsts.clear();
+			obst_grid.get_indices(p.cur_pos, obsts);
+			p.apply_behaviours(scene_fixed, obsts, steer_force);
+		}
+		else {
+			p.apply_behaviours(scene_fixed, steer_force);
+		}
+		if (use_neighbours and p.needs_neighbours()) {
+			cands.clear();
+			steer_grid.get_indices(p.cur_pos, cands);
+			sort(cands.begin(), cands.end());
+			p.apply_behaviours(aps, cands, steer_force);
+		}
+
+		// store force
+		truncate(steer_force, p.max_force, p.force);
+	}
+	}
+
+	// ... then update velocities and positions
+	vector<char> moved(aps.size(), 0);
+
+	#pragma omp parallel for num_threads(n)
+	for (size_t i = 0; i < aps.size(); ++i) {
+		agent_particle& p = aps[i];
+
+		// ignore fixed particles
+		if (p.fixed) {
+			continue;
+		}
+
+		vec3 accel;
+		__pm3_div_v_s(accel, p.force, p.mass);
+
+		vec3 pred_vel;
+		__pm3_add_v_vs(pred_vel, p.cur_vel, accel, dt);
+
+		vec3 pred_pos;
+		__pm3_add_v_vs(pred_pos, p.cur_pos, pred_vel, dt);
 
+		// collision prediction:
+		// copy the particle at its current state and use it
+		// to predict the update upon collision with geometry
+		agent_particle coll_pred = p;
+
+		bool collision =
+		find_update_geomcoll_sized(p, pred_pos, pred_vel, coll_pred);
+
+		// give the particle the proper final state
+		if (collision) {
+			p = coll_pred;
+		}
+		else {
+			p.save_position();
+			__pm3_assign_v(p.cur_pos, pred_pos);
+			__pm3_assign_v(p.cur_vel, pred_vel);
+		}
+
+		moved[i] = 1;
+	}
+
+	// Collisions between particles modify both particles
+	// involved. They are computed sequentially, after all
+	// particles have been moved.
+	if (part_part_colls_activated()) {
+		update_partcoll_agent(moved);
+	}
+
+	// compute new orientations
+	#pragma omp parallel for num_threads(n)
+	for (size_t i = 0; i < aps.size(); ++i) {
+		if (moved[i] == 0) {
+			continue;
+		}
+		agent_particle& p = aps[i];
+
+		vec3 alignment;
+		__pm3_sub_v_v(alignment, p.cur_vel, p.orientation);
+		normalise(alignment, alignment);
+		__pm3_add_acc_vs(p.orientation, alignment, p.align_weight);
+		normalise(p.orientation, p.orientation);
+	}
 }
 
 } // -- namespace physim
@@ -21,8 +21,13 @@
 
 #include <physim/simulator.hpp>
 
+// C includes
+#include <math.h>
+
 // C++ includes
+#include <algorithm>
 #include <iostream>
+#include <vector>
 using namespace std;
 
 // physim includes
@@ -84,6 +89,41 @@ using namespace particles;
  *
  */
 
+// -----------------------------------------------
+// BROAD PHASE
+
+/* Retrieves the indices of the fixed geometry whose bounding
+ * box overlaps the bounding box of the segment [p1,p2] grown
+ * by R, in increasing order. The indices are stored in 'small'
+ * if they fit, and in 'large' otherwise. Returns a pointer to
+ * the first index, and their amount in 'n'.
+ */
+static inline const size_t *geometry_candidates
+(
+	const structures::bvh& tree,
+	const vec3& p1, const vec3& p2, float R,
+	size_t *small, size_t n_small, vector<size_t>& large,
+	size_t& n
+)
+{
+	vec3 qmin, qmax;
+	__pm3_min2(qmin, p1,p2);
+	__pm3_max2(qmax, p1,p2);
+	__pm3_sub_acc_s(qmin, R);
+	__pm3_add_acc_s(qmax, R);
+
+	size_t *cands = small;
+	n = tree.get_indices(qmin,qmax, small, n_small);
+	if (n > n_small) {
+		large.resize(n);
+		tree.get_indices(qmin,qmax, &large[0], n);
+		cands = &large[0];
+	}
+
+	sort(cands, cands + n);
+	return cands;
+}
+
 // -----------------------------------------------
 // FREE PARTICLES
 
@@ -97,10 +137,29 @@ bool simulator::find_update_geomcoll_free
 	// has there been any collision?
 	bool collision = false;
 
-	// Check collision between the particle and
-	// every fixed geometrical object in the scene.
+	// Check collision between the particle and the fixed
+	// geometrical objects in the scene whose bounding box
+	// overlaps the segment travelled by the particle, in
+	// increasing order of index. A collision changes the
+	// segment: the remaining candidates are retrieved again.
+
+	size_t small[32];
+	vector<size_t> large;
+	size_t first = 0;
+	bool retrieve = true;
+
+	while (retrieve) {
+	retrieve = false;
+
+	size_t n_cands;
+	const size_t *cands = geometry_candidates
+		(geom_tree, p.cur_pos, pred_pos, 0.0f, small, 32, large, n_cands);
 
-	for (size_t i = 0; i < scene_fixed.size(); ++i) {
+	for (size_t c = 0; c < n_cands and not retrieve; ++c) {
+		const size_t i = cands[c];
+		if (i < first) {
+			continue;
+		}
 		const geometric::geometry *g = scene_fixed[i];
 
 		// if the particle collides with some geometry
@@ -129,6 +188,9 @@ bool simulator::find_update_geomcoll_free
 				// keep track of the predicted particle's position
 				__pm3_assign_v(pred_pos, coll_pred.cur_pos);
 				__pm3_assign_v(pred_vel, coll_pred.cur_vel);
+
+				first = i + 1;
+				retrieve = true;
 			}
 		}
 		else {
@@ -155,10 +217,14 @@ bool simulator::find_update_geomcoll_free
 				// keep track of the predicted particle's position
 				__pm3_assign_v(pred_pos, coll_pred.cur_pos);
 				__pm3_assign_v(pred_vel, coll_pred.cur_vel);
+
+				first = i + 1;
+				retrieve = true;
 			}
 		}
 
 	}
+	}
 
 	return collision;
 }
@@ -403,10 +469,29 @@ bool simulator::find_update_geomcoll_sized
 	// has there been any collision?
 	bool collision = false;
 
-	// Check collision between the particle and
-	// every fixed geometrical object in the scene.
+	// Check collision between the particle and the fixed
+	// geometrical objects in the scene whose bounding box
+	// overlaps the segment travelled by the particle, in
+	// increasing order of index. A collision changes the
+	// segment: the remaining candidates are retrieved again.
+
+	size_t small[32];
+	vector<size_t> large;
+	size_t first = 0;
+	bool retrieve = true;
+
+	while (retrieve) {
+	retrieve = false;
+
+	size_t n_cands;
+	const size_t *cands = geometry_candidates
+		(geom_tree, in.cur_pos, pred_pos, in.R, small, 32, large, n_cands);
 
-	for (size_t i = 0; i < scene_fixed.size(); ++i) {
+	for (size_t c = 0; c < n_cands and not retrieve; ++c) {
+		const size_t i = cands[c];
+		if (i < first) {
+			continue;
+		}
 		const geometric::geometry *g = scene_fixed[i];
 
 		// if the particle collides with some geometry
@@ -436,6 +521,9 @@ bool simulator::find_update_geomcoll_sized
 				// keep track of the predicted particle's position
 				__pm3_assign_v(pred_pos, coll_pred.cur_pos);
 				__pm3_assign_v(pred_vel, coll_pred.cur_vel);
+
+				first = i + 1;
+				retrieve = true;
 			}
 		}
 		else {
@@ -462,10 +550,14 @@ bool simulator::find_update_geomcoll_sized
 				// keep track of the predicted particle's position
 				__pm3_assign_v(pred_pos, coll_pred.cur_pos);
 				__pm3_assign_v(pred_vel, coll_pred.cur_vel);
+
+				first = i + 1;
+				retrieve = true;
 			}
 		}
 
 	}
+	}
 
 	return collision;
 }
@@ -521,7 +613,18 @@ void simulator::find_update_partcoll_sized
 {
 	vec3 v1,v2;
 
-	for (size_t j = i + 1; j < sps.size(); ++j) {
+	// candidates to collide with 'in', with an index larger
+	// than 'i', in the same order as without broad phase
+	coll_cands.clear();
+	sized_grid.get_indices(in.cur_pos, coll_cands);
+	coll_cands.erase(
+		remove_if(coll_cands.begin(), coll_cands.end(),
+			[i](size_t j) -> bool { return j <= i; }),
+		coll_cands.end()
+	);
+	sort(coll_cands.begin(), coll_cands.end());
+
+	for (size_t j : coll_cands) {
 
 		if (spart_spart_collision(in, sps[j])) {
 			// update the particle's position before
@@ -548,7 +651,11 @@ void simulator::find_update_partcoll_sized
 	}
 
 	// check collisions with other agent particles
-	for (size_t j = 0; j < aps.size(); ++j) {
+	coll_cands.clear();
+	agent_grid.get_indices(in.cur_pos, coll_cands);
+	sort(coll_cands.begin(), coll_cands.end());
+
+	for (size_t j : coll_cands) {
 
 		if (spart_spart_collision(in, aps[j])) {
 			// update the particle's position before
@@ -575,14 +682,92 @@ void simulator::find_update_partcoll_sized
 	}
 }
 
+void simulator::make_partcoll_grids() {
+	// largest radius and largest speed of the
+	// particles that may collide
+	float max_R = 0.0f;
+	float max_v2 = 0.0f;
+	for (const sized_particle& p : sps) {
+		max_R = std::max(max_R, p.R);
+		max_v2 = std::max(max_v2, __pm3_norm2(p.cur_vel));
+	}
+	for (const agent_particle& p : aps) {
+		max_R = std::max(max_R, p.R);
+		max_v2 = std::max(max_v2, __pm3_norm2(p.cur_vel));
+	}
+
+	/* Two particles collide if their centres are closer than the
+	 * sum of their radii, 2*max_R at most. The grid is built once
+	 * per pass, but the collisions resolved earlier in the pass
+	 * push the particles away from the position they were binned
+	 * at, so the cells leave room for this displacement.
+	 *
+	 * A particle is pushed at most by the depth of the overlap.
+	 * Assuming that the particles did not overlap at the beginning
+	 * of the step, the depth is at most the distance two particles
+	 * approach each other in a step, 2*max_speed*dt. Overlaps of
+	 * resting particles are bounded by 2*max_R instead. A particle
+	 * pushed several times in the same pass may still move further
+	 * than this, and its overlaps may be missed until the next step.
+	 */
+	const float max_push = std::max(2.0f*max_R, 2.0f*sqrtf(max_v2)*dt);
+	const float cell = (max_R > 0.0f ? 2.0f*max_R + max_push : 1.0f);
+
+	if (sps.size() > 0) {
+		sized_grid.init(&sps[0].cur_pos, sps.size(), sizeof(sized_particle), cell);
+	}
+	else {
+		sized_grid.reset();
+	}
+	if (aps.size() > 0) {
+		agent_grid.init(&aps[0].cur_pos, aps.size(), sizeof(agent_particle), cell);
+	}
+	else {
+		agent_grid.reset();
+	}
+}
+
+void simulator::update_partcoll_sized(const vector<char>& moved) {
+	if (sps.size() == 0) {
+		return;
+	}
+
+	make_partcoll_grids();
+
+	for (size_t i = 0; i < sps.size(); ++i) {
+		if (moved[i] == 1) {
+			find_update_partcoll_sized(sps[i], i);
+		}
+	}
+}
+
+void simulator::update_partcoll_agent(const vector<char>& moved) {
+	if (aps.size() == 0) {
+		return;
+	}
+
+	make_partcoll_grids();
+
+	for (size_t i = 0; i < aps.size(); ++i) {
+		if (moved[i] == 1) {
+			find_update_partcoll_agent(aps[i], i);
+		}
+	}
+}
+
 // particle 'in' has index 'i'
 void simulator::find_update_partcoll_agent
 (agent_particle& in, size_t i)
 {
 	vec3 v1,v2;
 
-	// check collisions with sized particles
-	for (size_t j = 0; j < sps.size(); ++j) {
+	// check collisions with sized particles, in
+	// the same order as without broad phase
+	coll_cands.clear();
+	sized_grid.get_indices(in.cur_pos, coll_cands);
+	sort(coll_cands.begin(), coll_cands.end());
+
+	for (size_t j : coll_cands) {
 
 		if (spart_spart_collision(in, sps[j])) {
 			// update the particle's position before
@@ -609,7 +794,17 @@ void simulator::find_update_partcoll_agent
 	}
 
 	// check collisions with other agent particles
-	for (size_t j = i + 1; j < aps.size(); ++j) {
+	// with an index larger than 'i'
+	coll_cands.clear();
+	agent_grid.get_indices(in.cur_pos, coll_cands);
+	coll_cands.erase(
+		remove_if(coll_cands.begin(), coll_cands.end(),
+			[i](size_t j) -> bool { return j <= i; }),
+		coll_cands.end()
+	);
+	sort(coll_cands.begin(), coll_cands.end());
+
+	for (size_t j : coll_cands) {
 
 		if (spart_spart_collision(in, aps[j])) {
 			// update the particle's position before
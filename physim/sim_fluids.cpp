@@ -36,122 +36,87 @@ using namespace particles;
 using namespace fluids;
 using namespace math;
 
-void simulator::_simulate_fluids() {
-
-	// collision prediction:
-	// copy the particle at its current state and use it
-	// to predict the update upon collision with geometry.
-	// Although it is a free particle, the attributes
-	// of the mesh particle will be copied into this one.
-	free_particle current;
-	free_particle coll_pred;
-	current.bouncing = 0.1f;
-	coll_pred.bouncing = 0.1f;
+template<solver_type S>
+void simulator::_simulate_fluids(size_t n) {
 
 	for (fluid *f : fs) {
 
-		current.friction = f->get_viscosity()/50000.0f;
-		coll_pred.friction = f->get_viscosity()/50000.0f;
-
 		/* update a meshe's particles */
 		fluid_particle *fluid_ps = f->get_particles();
 		size_t N = f->size();
 
-		// compute forces for particle p that are
-		// originated within the mesh's structure
-		f->update_forces();
-
-		for (size_t p_idx = 0; p_idx < N; ++p_idx) {
-
+		if (multistage<S>()) {
+			// predict the next position and velocity of every
+			// particle, with the forces of the fluid and of the
+			// force fields at every stage
+			apply_stages<S>(fluid_ps, nullptr, N, [f,n]() { f->update_forces(n); }, n);
+		}
+		else {
 			// compute forces for particle p that are
-			// originated by the force fields of the
-			// simulation
-			compute_forces(fluid_ps[p_idx]);
-
-			// apply solver to predict next position and
-			// velocity of the particle
-			vec3 pred_pos, pred_vel;
-			apply_solver(fluid_ps[p_idx], pred_pos, pred_vel);
-
-			// check if there is any collision between
-			// this mesh particle and a geometrical object
-
-			/* The algorithm for updating a particle's position
-			 * and velocity is the same as for a free particle.
-			 * The only change here is the call to the appropriate
-			 * function in the geometry class for a meshe's particle
-			 * update.
-			 */
-
-			from_fluid_to_free(fluid_ps[p_idx], current);
-			from_fluid_to_free(fluid_ps[p_idx], coll_pred);
+			// originated within the mesh's structure
+			f->update_forces(n);
 
-			bool collision =
-			find_update_geomcoll_free(current, pred_pos, pred_vel, coll_pred);
-
-			if (part_part_colls_activated()) {
-				bool r = find_update_partcoll_free
-				(current, pred_pos, pred_vel, coll_pred);
+			// compute the forces originated by the force
+			// fields of the simulation, in blocks
+			compute_forces(fluid_ps, nullptr, N, n);
 
-				collision = collision or r;
+			if (free_particles_collide()) {
+				// predict the next position and velocity
+				// of every particle, in blocks
+				predict_solver<S>(fluid_ps, nullptr, N, n);
 			}
+		}
 
-			// give the particle the proper final state
-			if (collision) {
-				from_free_to_fluid(coll_pred, fluid_ps[p_idx]);
+		if (not free_particles_collide()) {
+			if (multistage<S>()) {
+				#pragma omp parallel for num_threads(n) if(n > 1)
+				for (size_t p_idx = 0; p_idx < N; ++p_idx) {
+					const stage_state& st = stages[fluid_ps[p_idx].index];
+					fluid_ps[p_idx].save_position();
+					__pm3_assign_v(fluid_ps[p_idx].cur_pos, st.sum_pos);
+					__pm3_assign_v(fluid_ps[p_idx].cur_vel, st.sum_vel);
+				}
 			}
 			else {
-				fluid_ps[p_idx].save_position();
-				__pm3_assign_v(fluid_ps[p_idx].cur_pos, pred_pos);
-				__pm3_assign_v(fluid_ps[p_idx].cur_vel, pred_vel);
+				// move all particles in blocks
+				apply_solver<S>(fluid_ps, nullptr, N, n);
 			}
 
-			// clear the force so that in the next iteration
-			// for the mesh, the forces can be computed
-			__pm3_assign_s(fluid_ps[p_idx].force, 0.0f);
+			// clear the forces (see below)
+			#pragma omp parallel for num_threads(n) if(n > 1)
+			for (size_t p_idx = 0; p_idx < N; ++p_idx) {
+				__pm3_assign_s(fluid_ps[p_idx].force, 0.0f);
+			}
+			continue;
 		}
-	}
-}
-
-void simulator::_simulate_fluids(size_t n) {
-
-	// collision prediction:
-	// copy the particle at its current state and use it
-	// to predict the update upon collision with geometry.
-	// Although it is a free particle, the attributes
-	// of the mesh particle will be copied into this one.
-	free_particle current;
-	free_particle coll_pred;
-
-	for (fluid *f : fs) {
 
+		// see free_particles_parallel()
+		#pragma omp parallel num_threads(n) if(n > 1 and free_particles_parallel())
+		{
+		// collision prediction:
+		// copy the particle at its current state and use it
+		// to predict the update upon collision with geometry.
+		// Although it is a free particle, the attributes
+		// of the fluid particle will be copied into this one.
+		// One pair of particles per thread.
+		free_particle current;
+		free_particle coll_pred;
 		current.friction = f->get_viscosity()/50000.0f;
 		coll_pred.friction = f->get_viscosity()/50000.0f;
 
-		/* update a meshe's particles */
-		fluid_particle *fluid_ps = f->get_particles();
-		size_t N = f->size();
-
-		// compute forces for particle p that are
-		// originated within the mesh's structure
-		f->update_forces(n);
-
+		#pragma omp for
 		for (size_t p_idx = 0; p_idx < N; ++p_idx) {
 			current.bouncing = 0.1f;
 			coll_pred.bouncing = 0.1f;
 
-			// compute forces for particle p that are
-			// originated by the force fields of the
-			// simulation
-			compute_forces(fluid_ps[p_idx]);
-
-			// apply solver to predict next position and
-			// velocity of the particle
+			// already predicted
 			vec3 pred_pos, pred_vel;
-			apply_solver(fluid_ps[p_idx], pred_pos, pred_vel);
+			const stage_state& st = stages[fluid_ps[p_idx].index];
+			__pm3_assign_v(pred_pos, st.sum_pos);
+			__pm3_assign_v(pred_vel, st.sum_vel);
 
 			// check if there is any collision between
-			// this mesh particle and a geometrical object
+			// this fluid particle and a geometrical object
 
 			/* The algorithm for updating a particle's position
 			 * and velocity is the same as for a free particle.
@@ -187,6 +152,38 @@ void simulator::_simulate_fluids(size_t n) {
 			// for the mesh, the forces can be computed
 			__pm3_assign_s(fluid_ps[p_idx].force, 0.0f);
 		}
+		}
+	}
+}
+
+void simulator::_simulate_fluids() {
+	_simulate_fluids(1);
+}
+
+void simulator::_simulate_fluids(size_t n) {
+	// the solver is chosen once per step so that the
+	// loop over the particles is specialised for it
+	switch (solver) {
+		case solver_type::EulerOrig:
+			_simulate_fluids<solver_type::EulerOrig>(n);
+			break;
+		case solver_type::EulerSemi:
+			_simulate_fluids<solver_type::EulerSemi>(n);
+			break;
+		case solver_type::Verlet:
+			_simulate_fluids<solver_type::Verlet>(n);
+			break;
+		case solver_type::VelocityVerlet:
+			_simulate_fluids<solver_type::VelocityVerlet>(n);
+			break;
+		case solver_type::Leapfrog:
+			_simulate_fluids<solver_type::Leapfrog>(n);
+			break;
+		case solver_type::RK4:
+			_simulate_fluids<solver_type::RK4>(n);
+			break;
+		default:
+			cerr << "Warning: solver not implemented" << endl;
 	}
 }
 
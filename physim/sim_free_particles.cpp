@@ -24,6 +24,10 @@
 // C includes
 #include <omp.h>
 
+// C++ includes
+#include <vector>
+using namespace std;
+
 // physim includes
 #include <physim/math/private/math3.hpp>
 #include <physim/sim_solver.cpp>
@@ -32,7 +36,116 @@ namespace physim {
 using namespace particles;
 using namespace math;
 
+template<solver_type S>
+void simulator::_simulate_free_particles_block(size_t n) {
+	// the i-th particle has to be moved if move[i] = 1,
+	// and has to be reset if move[i] = 2
+	vector<char> move(fps.size(), 0);
+
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < fps.size(); ++i) {
+		free_particle& p = fps[i];
+
+		// ignore fixed particles
+		if (p.fixed) {
+			continue;
+		}
+		// Reset a particle when it dies.
+		// Do not smiulate this particle
+		// until the next step
+		if (p.lifetime <= 0.0f) {
+			move[i] = 2;
+			continue;
+		}
+		// is this particle allowed to move?
+		// if not, ignore it
+		p.reduce_starttime(dt);
+		if (p.starttime > 0.0f) {
+			continue;
+		}
+
+		// clear the current force
+		__pm3_assign_s(p.force, 0.0f);
+
+		// Particles age: reduce their lifetime.
+		p.reduce_lifetime(dt);
+
+		move[i] = 1;
+	}
+
+	// the emitter is not thread-safe
+	for (size_t i = 0; i < fps.size(); ++i) {
+		if (move[i] == 2) {
+			init_particle(fps[i]);
+			move[i] = 0;
+		}
+	}
+
+	if (fps.size() == 0) {
+		return;
+	}
+
+	// compute forces for the particles to be moved
+	compute_forces(&fps[0], move.data(), fps.size(), n);
+
+	if (scene_fixed.size() == 0) {
+		apply_solver<S>(&fps[0], move.data(), fps.size(), n);
+		return;
+	}
+
+	// state of the particles before moving them, to take
+	// back those that collide with the geometry
+	vector<vec3> prev_pos(fps.size());
+	vector<vec3> prev_vel(fps.size());
+
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < fps.size(); ++i) {
+		if (move[i] != 0) {
+			__pm3_assign_v(prev_pos[i], fps[i].prev_pos);
+			__pm3_assign_v(prev_vel[i], fps[i].cur_vel);
+		}
+	}
+
+	apply_solver<S>(&fps[0], move.data(), fps.size(), n);
+
+	#pragma omp parallel for num_threads(n) if(n > 1) schedule(dynamic, 256)
+	for (size_t i = 0; i < fps.size(); ++i) {
+		free_particle& p = fps[i];
+
+		if (move[i] == 0) {
+			continue;
+		}
+
+		// Take the particle back and use the new state as the
+		// prediction. Most particles do not collide, and are
+		// moved again to the same state.
+		vec3 pred_pos, pred_vel;
+		__pm3_assign_v(pred_pos, p.cur_pos);
+		__pm3_assign_v(pred_vel, p.cur_vel);
+		__pm3_assign_v(p.cur_pos, p.prev_pos);
+		__pm3_assign_v(p.prev_pos, prev_pos[i]);
+		__pm3_assign_v(p.cur_vel, prev_vel[i]);
+
+		// collision prediction (see _simulate_free_particles)
+		free_particle coll_pred;
+		if (find_update_geomcoll_free(p, pred_pos, pred_vel, coll_pred)) {
+			p = coll_pred;
+		}
+		else {
+			p.save_position();
+			__pm3_assign_v(p.cur_pos, pred_pos);
+			__pm3_assign_v(p.cur_vel, pred_vel);
+		}
+	}
+}
+
+template<solver_type S>
 void simulator::_simulate_free_particles() {
+	if (free_particles_parallel()) {
+		_simulate_free_particles_block<S>(1);
+		return;
+	}
+
 	for (free_particle& p : fps) {
 		// ignore fixed particles
 		if (p.fixed) {
@@ -63,7 +176,7 @@ void simulator::_simulate_free_particles() {
 		// apply solver to predict next position and
 		// velocity of the particle
 		vec3 pred_pos, pred_vel;
-		apply_solver(p, pred_pos, pred_vel);
+		apply_solver<S>(p, pred_pos, pred_vel);
 
 		// collision prediction:
 		// copy the particle at its current state and use it
@@ -95,4 +208,70 @@ void simulator::_simulate_free_particles() {
 	}
 }
 
+template<solver_type S>
+void simulator::_simulate_free_particles(size_t n) {
+	if (free_particles_parallel()) {
+		_simulate_free_particles_block<S>(n);
+		return;
+	}
+
+	// collisions between particles modify the sized and
+	// agent particles: see free_particles_parallel()
+	_simulate_free_particles<S>();
+}
+
+void simulator::_simulate_free_particles() {
+	// the solver is chosen once per step so that the
+	// loop over the particles is specialised for it
+	switch (solver) {
+		case solver_type::EulerOrig:
+			_simulate_free_particles<solver_type::EulerOrig>();
+			break;
+		case solver_type::EulerSemi:
+			_simulate_free_particles<solver_type::EulerSemi>();
+			break;
+		case solver_type::Verlet:
+			_simulate_free_particles<solver_type::Verlet>();
+			break;
+		case solver_type::VelocityVerlet:
+			_simulate_free_particles<solver_type::VelocityVerlet>();
+			break;
+		case solver_type::Leapfrog:
+			_simulate_free_particles<solver_type::Leapfrog>();
+			break;
+		case solver_type::RK4:
+			_simulate_free_particles<solver_type::RK4>();
+			break;
+		default:
+			cerr << "Warning: solver not implemented" << endl;
+	}
+}
+
+void simulator::_simulate_free_particles(size_t n) {
+	// the solver is chosen once per step so that the
+	// loop over the particles is specialised for it
+	switch (solver) {
+		case solver_type::EulerOrig:
+			_simulate_free_particles<solver_type::EulerOrig>(n);
+			break;
+		case solver_type::EulerSemi:
+			_simulate_free_particles<solver_type::EulerSemi>(n);
+			break;
+		case solver_type::Verlet:
+			_simulate_free_particles<solver_type::Verlet>(n);
+			break;
+		case solver_type::VelocityVerlet:
+			_simulate_free_particles<solver_type::VelocityVerlet>(n);
+			break;
+		case solver_type::Leapfrog:
+			_simulate_free_particles<solver_type::Leapfrog>(n);
+			break;
+		case solver_type::RK4:
+			_simulate_free_particles<solver_type::RK4>(n);
+			break;
+		default:
+			cerr << "Warning: solver not implemented" << endl;
+	}
+}
+
 } // -- namespace physim
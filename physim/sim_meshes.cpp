@@ -24,6 +24,10 @@
 // C includes
 #include <assert.h>
 
+// C++ includes
+#include <vector>
+using namespace std;
+
 // physim includes
 #include <physim/particles/conversions.hpp>
 #include <physim/math/private/math3/base.hpp>
@@ -34,52 +38,167 @@ using namespace particles;
 using namespace meshes;
 using namespace math;
 
-void simulator::_simulate_meshes() {
+void simulator::predict_implicit_mesh(mesh *m, const char *move, size_t n) {
+	mesh_particle *mps = m->get_particles();
+	const size_t N = m->size();
 
-	// collision prediction:
-	// copy the particle at its current state and use it
-	// to predict the update upon collision with geometry.
-	// Although it is a free particle, the attributes
-	// of the mesh particle will be copied into this one.
-	free_particle current;
-	free_particle coll_pred;
+	// the forces are those at the beginning of the step
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < N; ++i) {
+		__pm3_assign_s(mps[i].force, 0.0f);
+	}
+	m->update_forces(n);
+	compute_forces(mps, move, N, n);
 
-	for (mesh *m : ms) {
+	vector<vec3> dv(N);
+	m->solve_implicit(dt, dv.data());
 
-		// some of the meshe's attributes are needed
-		// in the collision prediction particle for...
-		// collision prediction
-		coll_pred.friction = m->get_friction();
-		coll_pred.bouncing = m->get_bouncing();
+	stages.resize(N);
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < N; ++i) {
+		if (move[i] == 1) {
+			stage_state& st = stages[mps[i].index];
+			__pm3_add_v_v(st.sum_vel, mps[i].cur_vel, dv[i]);
+			__pm3_add_v_vs(st.sum_pos, mps[i].cur_pos, st.sum_vel, dt);
+		}
+	}
+}
+
+void simulator::predict_position_based_mesh(mesh *m, const char *move, size_t n) {
+	mesh_particle *mps = m->get_particles();
+	const size_t N = m->size();
+
+	// only the forces of the force fields: the internal
+	// forces of the mesh are replaced by its constraints
+	vector<vec3> x(N);
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < N; ++i) {
+		__pm3_assign_s(mps[i].force, 0.0f);
+	}
+	compute_forces(mps, move, N, n);
+
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < N; ++i) {
+		__pm3_assign_v(x[i], mps[i].cur_pos);
+		if (move[i] == 1) {
+			vec3 v;
+			__pm3_add_v_vs(v, mps[i].cur_vel, mps[i].force, dt/mps[i].mass);
+			__pm3_add_acc_vs(x[i], v, dt);
+		}
+	}
+
+	m->solve_constraints(dt, x.data(), n);
+
+	stages.resize(N);
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < N; ++i) {
+		if (move[i] == 1) {
+			stage_state& st = stages[mps[i].index];
+			__pm3_assign_v(st.sum_pos, x[i]);
+			__pm3_sub_v_v(st.sum_vel, x[i], mps[i].cur_pos);
+			__pm3_div_v_s(st.sum_vel, st.sum_vel, dt);
+		}
+	}
+}
+
+template<solver_type S>
+void simulator::_simulate_meshes(size_t n) {
+	for (mesh *m : ms) {
 
 		/* update a meshe's particles */
 		mesh_particle *mps = m->get_particles();
 		size_t N = m->size();
 
-		// set forces to 0
+		// fixed particles do not move
+		vector<char> move(N, 0);
+		#pragma omp parallel for num_threads(n) if(n > 1)
 		for (size_t i = 0; i < N; ++i) {
-			__pm3_assign_s(mps[i].force, 0.0f);
+			move[i] = (mps[i].fixed ? 0 : 1);
+		}
+
+		// the next state of the particles of meshes integrated
+		// implicitly, simulated with position-based dynamics or
+		// with multistage solvers is predicted first
+		if (m->is_implicit()) {
+			predict_implicit_mesh(m, move.data(), n);
+		}
+		else if (m->is_position_based()) {
+			predict_position_based_mesh(m, move.data(), n);
 		}
+		else if (multistage<S>()) {
+			// predict the next position and velocity of every
+			// particle, with the forces of the mesh's structure
+			// and of the force fields at every stage
+			apply_stages<S>(mps, move.data(), N, [m,n]() { m->update_forces(n); }, n);
+		}
+		else {
+			// set forces to 0
+			#pragma omp parallel for num_threads(n) if(n > 1)
+			for (size_t i = 0; i < N; ++i) {
+				__pm3_assign_s(mps[i].force, 0.0f);
+			}
+
+			// compute forces for particle p that are
+			// originated within the mesh's structure
+			m->update_forces(n);
+
+			// compute the forces originated by the force
+			// fields of the simulation, in blocks
+			compute_forces(mps, move.data(), N, n);
+
+			if (not free_particles_collide()) {
+				// move all particles in blocks. The
+				// forces are set to 0 in the next step.
+				apply_solver<S>(mps, move.data(), N, n);
+				continue;
+			}
+
+			// predict the next position and velocity of
+			// every particle, in blocks
+			predict_solver<S>(mps, move.data(), N, n);
+		}
+
+		if (not free_particles_collide()) {
+			#pragma omp parallel for num_threads(n) if(n > 1)
+			for (size_t p_idx = 0; p_idx < N; ++p_idx) {
+				if (move[p_idx] == 1) {
+					mps[p_idx].save_position();
+					__pm3_assign_v(mps[p_idx].cur_pos, stages[mps[p_idx].index].sum_pos);
+					__pm3_assign_v(mps[p_idx].cur_vel, stages[mps[p_idx].index].sum_vel);
+				}
+			}
+			continue;
+		}
+
+		// see free_particles_parallel()
+		#pragma omp parallel num_threads(n) if(n > 1 and free_particles_parallel())
+		{
+		// collision prediction:
+		// copy the particle at its current state and use it
+		// to predict the update upon collision with geometry.
+		// Although it is a free particle, the attributes
+		// of the mesh particle will be copied into this one.
+		// One pair of particles per thread.
+		free_particle current;
+		free_particle coll_pred;
 
-		// compute forces for particle p that are
-		// originated within the mesh's structure
-		m->update_forces();
+		// some of the meshe's attributes are needed
+		// in the collision prediction particle for...
+		// collision prediction
+		coll_pred.friction = m->get_friction();
+		coll_pred.bouncing = m->get_bouncing();
 
+		#pragma omp for
 		for (size_t p_idx = 0; p_idx < N; ++p_idx) {
 			// ignore fixed particles
-			if (mps[p_idx].fixed) {
+			if (move[p_idx] == 0) {
 				continue;
 			}
 
-			// compute forces for particle p that are
-			// originated by the force fields of the
-			// simulation
-			compute_forces(mps[p_idx]);
-
-			// apply solver to predict next position and
-			// velocity of the particle
+			// already predicted
 			vec3 pred_pos, pred_vel;
-			apply_solver(mps[p_idx], pred_pos, pred_vel);
+			__pm3_assign_v(pred_pos, stages[mps[p_idx].index].sum_pos);
+			__pm3_assign_v(pred_vel, stages[mps[p_idx].index].sum_vel);
 
 			// check if there is any collision between
 			// this mesh particle and a geometrical object
@@ -118,6 +237,38 @@ void simulator::_simulate_meshes() {
 			// for the mesh, the forces can be computed
 			__pm3_assign_s(mps[p_idx].force, 0.0f);
 		}
+		}
+	}
+}
+
+void simulator::_simulate_meshes() {
+	_simulate_meshes(1);
+}
+
+void simulator::_simulate_meshes(size_t n) {
+	// the solver is chosen once per step so that the
+	// loop over the particles is specialised for it
+	switch (solver) {
+		case solver_type::EulerOrig:
+			_simulate_meshes<solver_type::EulerOrig>(n);
+			break;
+		case solver_type::EulerSemi:
+			_simulate_meshes<solver_type::EulerSemi>(n);
+			break;
+		case solver_type::Verlet:
+			_simulate_meshes<solver_type::Verlet>(n);
+			break;
+		case solver_type::VelocityVerlet:
+			_simulate_meshes<solver_type::VelocityVerlet>(n);
+			break;
+		case solver_type::Leapfrog:
+			_simulate_meshes<solver_type::Leapfrog>(n);
+			break;
+		case solver_type::RK4:
+			_simulate_meshes<solver_type::RK4>(n);
+			break;
+		default:
+			cerr << "Warning: solver not implemented" << endl;
 	}
 }
 
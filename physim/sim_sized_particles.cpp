@@ -21,6 +21,10 @@
 
 #include <physim/simulator.hpp>
 
+// C++ includes
+#include <vector>
+using namespace std;
+
 // physim includes
 #include <physim/math/private/math3/base.hpp>
 #include <physim/sim_solver.cpp>
@@ -29,8 +33,15 @@ namespace physim {
 using namespace particles;
 using namespace math;
 
-void simulator::_simulate_sized_particles() {
+template<solver_type S>
+void simulator::_simulate_sized_particles(size_t n) {
+	// State of every particle:
+	// 0 -> not simulated, 1 -> simulated, 2 -> to be reset.
+	// Particles that die are reset sequentially since the
+	// emitter is not thread-safe.
+	vector<char> state(sps.size(), 0);
 
+	#pragma omp parallel for num_threads(n) if(n > 1)
 	for (size_t i = 0; i < sps.size(); ++i) {
 		sized_particle& p = sps[i];
 
@@ -42,7 +53,7 @@ void simulator::_simulate_sized_particles() {
 		// Do not smiulate this particle
 		// until the next step
 		if (p.lifetime <= 0.0f) {
-			init_particle(p);
+			state[i] = 2;
 			continue;
 		}
 		// is this particle allowed to move?
@@ -54,16 +65,40 @@ void simulator::_simulate_sized_particles() {
 
 		// clear the current force
 		__pm3_assign_s(p.force, 0.0f);
-		// compute forces for particle p
-		compute_forces(p);
 
 		// Particles age: reduce their lifetime.
 		p.reduce_lifetime(dt);
 
+		state[i] = 1;
+	}
+
+	// reset dead particles in order
+	for (size_t i = 0; i < sps.size(); ++i) {
+		if (state[i] == 2) {
+			init_particle(sps[i]);
+			state[i] = 0;
+		}
+	}
+
+	if (sps.size() == 0) {
+		return;
+	}
+
+	// compute forces for the particles to be moved
+	compute_forces(&sps[0], state.data(), sps.size(), n);
+
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < sps.size(); ++i) {
+		sized_particle& p = sps[i];
+
+		if (state[i] == 0) {
+			continue;
+		}
+
 		// apply solver to predict next position and
 		// velocity of the particle
 		vec3 pred_pos, pred_vel;
-		apply_solver(p, pred_pos, pred_vel);
+		apply_solver<S>(p, pred_pos, pred_vel);
 
 		// collision prediction:
 		// copy the particle at its current state and use it
@@ -85,16 +120,45 @@ void simulator::_simulate_sized_particles() {
 			__pm3_assign_v(p.cur_pos, pred_pos);
 			__pm3_assign_v(p.cur_vel, pred_vel);
 		}
+	}
 
-		// Now it is time to perform collisions between particles.
-		// A data structure would come really in handy but, for now,
-		// a linear-time algorithm (for every particle) will be used.
-
-		if (part_part_colls_activated()) {
-			find_update_partcoll_sized(p, i);
-		}
+	// Collisions between particles modify both particles
+	// involved. They are computed sequentially, after all
+	// particles have been moved.
+	if (part_part_colls_activated()) {
+		update_partcoll_sized(state);
 	}
+}
+
+void simulator::_simulate_sized_particles() {
+	_simulate_sized_particles(1);
+}
 
+void simulator::_simulate_sized_particles(size_t n) {
+	// the solver is chosen once per step so that the
+	// loop over the particles is specialised for it
+	switch (solver) {
+		case solver_type::EulerOrig:
+			_simulate_sized_particles<solver_type::EulerOrig>(n);
+			break;
+		case solver_type::EulerSemi:
+			_simulate_sized_particles<solver_type::EulerSemi>(n);
+			break;
+		case solver_type::Verlet:
+			_simulate_sized_particles<solver_type::Verlet>(n);
+			break;
+		case solver_type::VelocityVerlet:
+			_simulate_sized_particles<solver_type::VelocityVerlet>(n);
+			break;
+		case solver_type::Leapfrog:
+			_simulate_sized_particles<solver_type::Leapfrog>(n);
+			break;
+		case solver_type::RK4:
+			_simulate_sized_particles<solver_type::RK4>(n);
+			break;
+		default:
+			cerr << "Warning: solver not implemented" << endl;
+	}
 }
 
 } // -- namespace physim
@@ -31,20 +31,31 @@
 #include <physim/math/vec3.hpp>
 #include <physim/math/private/math3.hpp>
 
+// C includes
+#include <assert.h>
+
 // C++ includes
+#include <algorithm>
 #include <iostream>
 #include <vector>
 using namespace std;
 
+// number of particles the force fields are evaluated on at once
+#define FIELD_BATCH 256
+
 namespace physim {
 using namespace math;
 using namespace fields;
 
-template<class P>
-void simulator::apply_solver(const P& p, vec3& pred_pos, vec3& pred_vel) {
+template<solver_type S, class P>
+void simulator::apply_solver
+(const P& p, float dt, vec3& pred_pos, vec3& pred_vel)
+{
 	const float mass = p.mass;
 
-	switch (solver) {
+	// S is known at compile time: only one of
+	// these cases is compiled in each instance
+	switch (S) {
 		case solver_type::EulerOrig:
 			// pred_pos <- pos + vel*dt
 			__pm3_add_v_vs(pred_pos, p.cur_pos, p.cur_vel, dt);
@@ -73,6 +84,221 @@ void simulator::apply_solver(const P& p, vec3& pred_pos, vec3& pred_vel) {
 	}
 }
 
+template<solver_type S, class P>
+void simulator::apply_solver(const P& p, vec3& pred_pos, vec3& pred_vel) {
+	if (not multistage<S>()) {
+		apply_solver<S>(p, dt, pred_pos, pred_vel);
+		return;
+	}
+
+	// the stages are applied on a copy of the particle
+	P q(p);
+	stage_state st;
+	begin_stages<S>(q, st, dt);
+	for (size_t s = 0; s < n_stages<S>(); ++s) {
+		// the force at the current state has already been
+		// computed, but the leapfrog evaluates it elsewhere
+		if (s > 0 or S == solver_type::Leapfrog) {
+			__pm3_assign_s(q.force, 0.0f);
+			compute_forces(q);
+		}
+		apply_stage<S>(s, q, st, dt);
+	}
+	__pm3_assign_v(pred_pos, st.sum_pos);
+	__pm3_assign_v(pred_vel, st.sum_vel);
+}
+
+template<solver_type S>
+constexpr bool simulator::multistage() {
+	return
+		S == solver_type::VelocityVerlet or
+		S == solver_type::Leapfrog or
+		S == solver_type::RK4;
+}
+
+template<solver_type S>
+constexpr size_t simulator::n_stages() {
+	return
+		(S == solver_type::VelocityVerlet ? 2 :
+		(S == solver_type::RK4 ? 4 : 1));
+}
+
+template<solver_type S, class P>
+void simulator::begin_stages(P& p, stage_state& st, float dt) {
+	__pm3_assign_v(st.pos, p.cur_pos);
+	__pm3_assign_v(st.vel, p.cur_vel);
+	__pm3_assign_s(st.sum_pos, 0.0f);
+	__pm3_assign_s(st.sum_vel, 0.0f);
+
+	if (S == solver_type::Leapfrog) {
+		// drift: half position <- pos + vel*dt/2
+		__pm3_add_acc_vs(p.cur_pos, p.cur_vel, 0.5f*dt);
+	}
+}
+
+template<solver_type S, class P>
+void simulator::apply_stage(size_t s, P& p, stage_state& st, float dt) {
+	// acceleration at the current state
+	const vec3 acc = p.force*__pm_inv(p.mass);
+
+	switch (S) {
+		case solver_type::VelocityVerlet:
+			// kick: vel <- vel + acc*dt/2
+			__pm3_add_acc_vs(p.cur_vel, acc, 0.5f*dt);
+			if (s == 0) {
+				// drift: pos <- pos + half vel*dt
+				__pm3_add_acc_vs(p.cur_pos, p.cur_vel, dt);
+				return;
+			}
+			break;
+
+		case solver_type::Leapfrog:
+			// kick: vel <- vel + acc*dt
+			__pm3_add_acc_vs(p.cur_vel, acc, dt);
+			// drift: pos <- half pos + vel*dt/2
+			__pm3_add_acc_vs(p.cur_pos, p.cur_vel, 0.5f*dt);
+			break;
+
+		case solver_type::RK4: {
+			// weight of the derivatives of this stage
+			const float w = (s == 0 or s == 3 ? 1.0f : 2.0f);
+			__pm3_add_acc_vs(st.sum_pos, p.cur_vel, w);
+			__pm3_add_acc_vs(st.sum_vel, acc, w);
+
+			if (s < 3) {
+				// state of the next stage
+				const float h = (s < 2 ? 0.5f*dt : dt);
+				__pm3_add_v_vs(p.cur_pos, st.pos, p.cur_vel, h);
+				__pm3_add_v_vs(p.cur_vel, st.vel, acc, h);
+				return;
+			}
+
+			// state <- initial state + dt/6*(sum of derivatives)
+			__pm3_add_v_vs(p.cur_pos, st.pos, st.sum_pos, dt/6.0f);
+			__pm3_add_v_vs(p.cur_vel, st.vel, st.sum_vel, dt/6.0f);
+			break;
+		}
+
+		default:
+			cerr << "Warning: solver without stages" << endl;
+			return;
+	}
+
+	// last stage: keep the predicted state and
+	// move the particle back to its initial state
+	__pm3_assign_v(st.sum_pos, p.cur_pos);
+	__pm3_assign_v(st.sum_vel, p.cur_vel);
+	__pm3_assign_v(p.cur_pos, st.pos);
+	__pm3_assign_v(p.cur_vel, st.vel);
+}
+
+template<solver_type S, class P, class F>
+void simulator::apply_stages
+(P *ps, const char *move, size_t N, const F& internal, size_t n)
+{
+	stages.resize(N);
+
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < N; ++i) {
+		if (move == nullptr or move[i] != 0) {
+			begin_stages<S>(ps[i], stages[ps[i].index], dt);
+		}
+	}
+
+	for (size_t s = 0; s < n_stages<S>(); ++s) {
+		#pragma omp parallel for num_threads(n) if(n > 1)
+		for (size_t i = 0; i < N; ++i) {
+			__pm3_assign_s(ps[i].force, 0.0f);
+		}
+
+		internal();
+		compute_forces(ps, move, N, n);
+
+		#pragma omp parallel for num_threads(n) if(n > 1)
+		for (size_t i = 0; i < N; ++i) {
+			if (move == nullptr or move[i] != 0) {
+				apply_stage<S>(s, ps[i], stages[ps[i].index], dt);
+			}
+		}
+	}
+}
+
+template<solver_type S, class P>
+void simulator::apply_solver(P *ps, size_t N) {
+	// a copy of the time step, which the compiler
+	// can not assume is not modified in the loop
+	const float h = dt;
+
+	if (multistage<S>()) {
+		// the forces are evaluated at every stage
+		for (size_t i = 0; i < N; ++i) {
+			vec3 pred_pos, pred_vel;
+			apply_solver<S>(ps[i], pred_pos, pred_vel);
+			ps[i].save_position();
+			__pm3_assign_v(ps[i].cur_pos, pred_pos);
+			__pm3_assign_v(ps[i].cur_vel, pred_vel);
+		}
+		return;
+	}
+
+	#pragma omp simd
+	for (size_t i = 0; i < N; ++i) {
+		vec3 pred_pos, pred_vel;
+		apply_solver<S>(ps[i], h, pred_pos, pred_vel);
+
+		// same as save_position(), but inlined
+		__pm3_assign_v(ps[i].prev_pos, ps[i].cur_pos);
+		__pm3_assign_v(ps[i].cur_pos, pred_pos);
+		__pm3_assign_v(ps[i].cur_vel, pred_vel);
+	}
+}
+
+template<solver_type S, class P>
+void simulator::apply_solver(P *ps, const char *move, size_t N, size_t n) {
+	// one block per thread
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t t = 0; t < n; ++t) {
+		const size_t e = (t + 1)*N/n;
+		size_t i = t*N/n;
+
+		if (move == nullptr) {
+			apply_solver<S>(ps + i, e - i);
+			continue;
+		}
+
+		while (i < e) {
+			// find the next run [i,j) of particles to be moved
+			while (i < e and move[i] == 0) {
+				++i;
+			}
+			size_t j = i;
+			while (j < e and move[j] != 0) {
+				++j;
+			}
+			apply_solver<S>(ps + i, j - i);
+			i = j;
+		}
+	}
+}
+
+template<solver_type S, class P>
+void simulator::predict_solver(P *ps, const char *move, size_t N, size_t n) {
+	assert(not multistage<S>());
+
+	// see apply_solver(P*,size_t)
+	const float h = dt;
+
+	stages.resize(N);
+
+	#pragma omp parallel for num_threads(n) if(n > 1)
+	for (size_t i = 0; i < N; ++i) {
+		if (move == nullptr or move[i] != 0) {
+			stage_state& st = stages[ps[i].index];
+			apply_solver<S>(ps[i], h, st.sum_pos, st.sum_vel);
+		}
+	}
+}
+
 template<class P>
 void simulator::compute_forces(P& p) {
 	// compute the force every force field makes on every particle
@@ -86,4 +312,37 @@ void simulator::compute_forces(P& p) {
 	__pm3_add_acc_vs(p.force, p.cur_vel, -visc_drag);
 }
 
+template<class P>
+void simulator::compute_forces(P *ps, const char *move, size_t N, size_t n) {
+	#pragma omp parallel num_threads(n) if(n > 1)
+	{
+	// forces of a field on the particles of a batch
+	vec3 F[FIELD_BATCH];
+
+	#pragma omp for
+	for (size_t b = 0; b < N; b += FIELD_BATCH) {
+		const size_t m = std::min(static_cast<size_t>(FIELD_BATCH), N - b);
+		P *batch = ps + b;
+
+		// accumulate the forces of the fields in
+		// the same order as in compute_forces(P&)
+		for (field *f : force_fields) {
+			f->compute_forces(batch, m, F);
+			for (size_t i = 0; i < m; ++i) {
+				if (move == nullptr or move[b + i] != 0) {
+					__pm3_add_acc_v(batch[i].force, F[i]);
+				}
+			}
+		}
+
+		// apply viscous drag
+		for (size_t i = 0; i < m; ++i) {
+			if (move == nullptr or move[b + i] != 0) {
+				__pm3_add_acc_vs(batch[i].force, batch[i].cur_vel, -visc_drag);
+			}
+		}
+	}
+	}
+}
+
 } // -- namespace physim
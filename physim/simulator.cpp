@@ -25,6 +25,8 @@
 #include <assert.h>
 
 // C++ includes
+#include <iostream>
+#include <algorithm>
 using namespace std;
 
 // physim includes
@@ -88,16 +90,89 @@ void simulator::init_fluid(fluid *f) {
 	}
 }
 
+void simulator::make_geometry_tree() {
+	vector<vec3> mins(scene_fixed.size());
+	vector<vec3> maxs(scene_fixed.size());
+	for (size_t i = 0; i < scene_fixed.size(); ++i) {
+		__pm3_assign_v(mins[i], scene_fixed[i]->get_min());
+		__pm3_assign_v(maxs[i], scene_fixed[i]->get_max());
+	}
+	geom_tree.init(mins, maxs);
+	geom_tree_dirty = false;
+}
+
+float simulator::compute_time_step() {
+	float h = max_dt;
+
+	// collisions: the radius of sized and agent particles
+	for (const sized_particle& p : sps) {
+		const float speed = __pm3_norm(p.cur_vel);
+		if (speed > 0.0f) {
+			h = std::min(h, cfl*p.R/speed);
+		}
+	}
+	for (const agent_particle& p : aps) {
+		const float speed = __pm3_norm(p.cur_vel);
+		if (speed > 0.0f) {
+			h = std::min(h, cfl*p.R/speed);
+		}
+	}
+
+	// meshes: stiffness of the springs
+	for (mesh *m : ms) {
+		if (not m->is_implicit() and not m->is_position_based()) {
+			h = std::min(h, cfl*m->compute_stable_time_step());
+		}
+	}
+
+	// fluids: neighbourhood size
+	for (const fluid *f : fs) {
+		const fluid_particle *fps = f->get_particles();
+		float max_speed2 = 0.0f;
+		for (size_t i = 0; i < f->size(); ++i) {
+			max_speed2 = std::max(max_speed2, __pm3_norm2(fps[i].cur_vel));
+		}
+		const float speed = std::sqrt(max_speed2) + f->get_speed_sound();
+		if (speed > 0.0f) {
+			h = std::min(h, cfl*f->get_neighbourhood_size()/speed);
+		}
+	}
+
+	return std::max(min_dt, h);
+}
+
+void simulator::_apply_time_step(size_t n) {
+	// the fields caused by the free particles
+	// are those at the beginning of the step
+	for (field *f : force_fields) {
+		f->update(fps.data(), fps.size(), n);
+	}
+
+	simulate_sized_particles(n);
+	simulate_agent_particles(n);
+	simulate_free_particles(n);
+	simulate_meshes(n);
+	simulate_fluids(n);
+	sim_time += dt;
+}
+
 // PUBLIC
 
 simulator::simulator(const solver_type& s, float t) {
 	__pm3_assign_c(gravity, 0.0f, -9.81f, 0.0f);
 	dt = t;
+	adaptive_dt = false;
+	min_dt = 0.0001f;
+	max_dt = 0.02f;
+	cfl = 0.4f;
+	sim_time = 0.0;
 	solver = s;
 	visc_drag = 0.05f;
 	free_global_emit = new emitters::free_emitter();
 	sized_global_emit = new emitters::sized_emitter();
 	part_part_collisions = false;
+	geom_tree_dirty = false;
+	obst_distance = -1.0f;
 }
 
 simulator::~simulator() {
@@ -194,10 +269,13 @@ void simulator::clear_free_particles() {
 
 void simulator::clear_sized_particles() {
 	sps.clear();
+	sized_grid.clear();
 }
 
 void simulator::clear_agent_particles() {
 	aps.clear();
+	agent_grid.clear();
+	steer_grid.clear();
 }
 
 void simulator::clear_particles() {
@@ -210,14 +288,25 @@ void simulator::clear_particles() {
 
 size_t simulator::add_geometry(geometry *g) {
 	scene_fixed.push_back(g);
+	geom_tree_dirty = true;
+	obst_distance = -1.0f;
 	return scene_fixed.size();
 }
 
+void simulator::update_geometry() {
+	geom_tree_dirty = true;
+	obst_distance = -1.0f;
+}
+
 void simulator::clear_geometry() {
 	for (geometry *g : scene_fixed) {
 		delete g;
 	}
 	scene_fixed.clear();
+	geom_tree.clear();
+	geom_tree_dirty = false;
+	obst_grid.clear();
+	obst_distance = -1.0f;
 }
 
 // ----------- fields
@@ -287,27 +376,97 @@ void simulator::reset_simulation() {
 }
 
 void simulator::simulate_free_particles() {
+	if (geom_tree_dirty) {
+		make_geometry_tree();
+	}
 	_simulate_free_particles();
 }
 
+void simulator::simulate_free_particles(size_t nt) {
+	assert(nt > 0);
+	if (geom_tree_dirty) {
+		make_geometry_tree();
+	}
+	if (nt == 1) {
+		_simulate_free_particles();
+	}
+	else {
+		_simulate_free_particles(nt);
+	}
+}
+
 void simulator::simulate_sized_particles() {
+	if (geom_tree_dirty) {
+		make_geometry_tree();
+	}
 	_simulate_sized_particles();
 }
 
+void simulator::simulate_sized_particles(size_t nt) {
+	assert(nt > 0);
+	if (geom_tree_dirty) {
+		make_geometry_tree();
+	}
+	if (nt == 1) {
+		_simulate_sized_particles();
+	}
+	else {
+		_simulate_sized_particles(nt);
+	}
+}
+
 void simulator::simulate_agent_particles() {
+	if (geom_tree_dirty) {
+		make_geometry_tree();
+	}
 	_simulate_agent_particles();
 }
 
+void simulator::simulate_agent_particles(size_t nt) {
+	assert(nt > 0);
+	if (geom_tree_dirty) {
+		make_geometry_tree();
+	}
+	if (nt == 1) {
+		_simulate_agent_particles();
+	}
+	else {
+		_simulate_agent_particles(nt);
+	}
+}
+
 void simulator::simulate_meshes() {
+	if (geom_tree_dirty) {
+		make_geometry_tree();
+	}
 	_simulate_meshes();
 }
 
+void simulator::simulate_meshes(size_t nt) {
+	assert(nt > 0);
+	if (geom_tree_dirty) {
+		make_geometry_tree();
+	}
+	if (nt == 1) {
+		_simulate_meshes();
+	}
+	else {
+		_simulate_meshes(nt);
+	}
+}
+
 void simulator::simulate_fluids() {
+	if (geom_tree_dirty) {
+		make_geometry_tree();
+	}
 	_simulate_fluids();
 }
 
 void simulator::simulate_fluids(size_t nt) {
 	assert(nt > 0);
+	if (geom_tree_dirty) {
+		make_geometry_tree();
+	}
 	if (nt == 1) {
 		_simulate_fluids();
 	}
@@ -317,19 +476,47 @@ void simulator::simulate_fluids(size_t nt) {
 }
 
 void simulator::apply_time_step() {
-	simulate_sized_particles();
-	simulate_agent_particles();
-	simulate_free_particles();
-	simulate_meshes();
-	simulate_fluids();
+	apply_time_step(1);
 }
 
 void simulator::apply_time_step(size_t nt) {
-	simulate_sized_particles();
-	simulate_agent_particles();
-	simulate_free_particles();
-	simulate_meshes();
-	simulate_fluids(nt);
+	if (adaptive_dt) {
+		dt = compute_time_step();
+	}
+	_apply_time_step(nt);
+}
+
+void simulator::simulate_until(float t, size_t nt) {
+	const float fixed_dt = dt;
+	assert(adaptive_dt or fixed_dt > 0.0f);
+
+	while (sim_time < t) {
+		dt = (adaptive_dt ? compute_time_step() : fixed_dt);
+		if (sim_time + dt == sim_time) {
+			cerr << "simulator::simulate_until (" << __LINE__ << ") - Error:" << endl;
+			cerr << "    The time step " << dt << " does not advance the "
+				 << "simulated time " << sim_time << endl;
+			break;
+		}
+		if (dt < t - sim_time) {
+			// split the time left in two equal steps
+			// rather than leaving a very short last step
+			if (2.0f*dt > t - sim_time) {
+				dt = 0.5f*(t - sim_time);
+			}
+			_apply_time_step(nt);
+		}
+		else {
+			// the last step ends exactly at time t
+			dt = t - sim_time;
+			_apply_time_step(nt);
+			sim_time = t;
+		}
+	}
+
+	if (not adaptive_dt) {
+		dt = fixed_dt;
+	}
 }
 
 // SETTERS
@@ -344,6 +531,21 @@ void simulator::set_time_step(float t) {
 	dt = t;
 }
 
+void simulator::set_adaptive_time_step(bool a) {
+	adaptive_dt = a;
+}
+
+void simulator::set_time_step_bounds(float m, float M) {
+	assert(0.0f < m and m <= M);
+	min_dt = m;
+	max_dt = M;
+}
+
+void simulator::set_cfl_number(float c) {
+	assert(c > 0.0f);
+	cfl = c;
+}
+
 void simulator::set_viscous_drag(float d) {
 	assert(d >= 0.0f);
 	visc_drag = d;
@@ -470,8 +672,36 @@ float simulator::get_time_step() const {
 	return dt;
 }
 
+bool simulator::is_time_step_adaptive() const {
+	return adaptive_dt;
+}
+
+float simulator::get_min_time_step() const {
+	return min_dt;
+}
+
+float simulator::get_max_time_step() const {
+	return max_dt;
+}
+
+float simulator::get_cfl_number() const {
+	return cfl;
+}
+
+double simulator::get_simulated_time() const {
+	return sim_time;
+}
+
 bool simulator::part_part_colls_activated() const {
 	return part_part_collisions;
 }
 
+bool simulator::free_particles_parallel() const {
+	return not part_part_collisions or (sps.size() == 0 and aps.size() == 0);
+}
+
+bool simulator::free_particles_collide() const {
+	return scene_fixed.size() > 0 or not free_particles_parallel();
+}
+
 } // -- namespace physim
@@ -35,6 +35,9 @@
 #include <physim/particles/free_particle.hpp>
 #include <physim/meshes/mesh.hpp>
 #include <physim/fluids/fluid.hpp>
+#include <physim/structures/hash_grid.hpp>
+#include <physim/structures/bvh.hpp>
+#include <physim/structures/obstacle_grid.hpp>
 
 namespace physim {
 
@@ -46,6 +49,14 @@ namespace physim {
  * - EulerOrig: see @ref solver_type::EulerOrig.
  * - EulerSemi: see @ref solver_type::EulerSemi.
  * - Verlet: see @ref solver_type::Verlet.
+ * - VelocityVerlet: see @ref solver_type::VelocityVerlet.
+ * - Leapfrog: see @ref solver_type::Leapfrog.
+ * - RK4: see @ref solver_type::RK4.
+ *
+ * The last three solvers evaluate the forces more than once per
+ * time step, or at a state different from the current one. These
+ * evaluations are called stages. Meshes and fluids evaluate their
+ * internal forces at every stage.
  */
 enum class solver_type : int8_t {
 	none = -1,
@@ -86,7 +97,46 @@ enum class solver_type : int8_t {
 	 * - dt    :: time step
 	 * - mass  :: particle's mass
 	 */
-	Verlet
+	Verlet,
+
+	/**
+	 * Velocity Verlet (kick-drift-kick) solver. The velocity is
+	 * updated in two halves, with the forces at the current
+	 * position and at the new position.
+	 \verbatim
+	 half velocity = vc + dt/2 * force(xc, vc) / mass
+	 new position = xc + dt * half velocity
+	 new velocity = half velocity + dt/2 * force(new position, half velocity) / mass
+	 \endverbatim
+	 * Second order. Two stages.
+	 */
+	VelocityVerlet,
+
+	/**
+	 * Symplectic leapfrog (drift-kick-drift) solver. The position is
+	 * updated in two halves, with the forces at the midpoint.
+	 \verbatim
+	 half position = xc + dt/2 * vc
+	 new velocity = vc + dt * force(half position, vc) / mass
+	 new position = half position + dt/2 * new velocity
+	 \endverbatim
+	 * Second order. One stage, at the half position.
+	 */
+	Leapfrog,
+
+	/**
+	 * Classical fourth order Runge-Kutta solver, applied on
+	 * the position and velocity of the particles.
+	 \verbatim
+	 k1 = (vc, force(xc, vc)/mass)
+	 k2 = derivatives at (xc, vc) + dt/2 * k1
+	 k3 = derivatives at (xc, vc) + dt/2 * k2
+	 k4 = derivatives at (xc, vc) + dt * k3
+	 (new position, new velocity) = (xc, vc) + dt/6 * (k1 + 2*k2 + 2*k3 + k4)
+	 \endverbatim
+	 * Four stages.
+	 */
+	RK4
 };
 
 /**
@@ -117,6 +167,24 @@ class simulator {
 		 * This position is, then, fixed.
 		 */
 		std::vector<geometric::geometry *> scene_fixed;
+		/**
+		 * @brief Hierarchy of the bounding boxes of the fixed geometry.
+		 *
+		 * The @e i-th box is the bounding box of the @e i-th object in
+		 * @ref scene_fixed (see @ref geometric::geometry::get_min,
+		 * @ref geometric::geometry::get_max). Rebuilt every time the
+		 * collection of fixed geometry changes, when the particles are
+		 * simulated next (see @ref geom_tree_dirty).
+		 */
+		structures::bvh geom_tree;
+		/**
+		 * @brief Whether @ref geom_tree has to be rebuilt.
+		 *
+		 * Set when the fixed geometry changes (see @ref add_geometry,
+		 * @ref update_geometry), so that a scene added object by object
+		 * builds the hierarchy only once.
+		 */
+		bool geom_tree_dirty;
 		/// Collection of force fields.
 		std::vector<fields::field *> force_fields;
 		/// The collection of free particles in the simulation.
@@ -137,8 +205,40 @@ class simulator {
 		 * @brief Time step of the simulation.
 		 *
 		 * Default value: 0.01.
+		 *
+		 * When the time step is adaptive (see @ref adaptive_dt), this is
+		 * the time step of the last step applied.
 		 */
 		float dt;
+		/**
+		 * @brief Is the time step chosen at every step?
+		 *
+		 * When it is, the time step is computed before every step with
+		 * a CFL condition (see @ref compute_time_step).
+		 *
+		 * Default value: false.
+		 */
+		bool adaptive_dt;
+		/// Minimum adaptive time step. Default value: 0.0001.
+		float min_dt;
+		/// Maximum adaptive time step. Default value: 0.02.
+		float max_dt;
+		/**
+		 * @brief Courant number of the adaptive time step.
+		 *
+		 * Fraction of the largest time step allowed by every CFL
+		 * condition (see @ref compute_time_step).
+		 *
+		 * Default value: 0.4.
+		 */
+		float cfl;
+		/**
+		 * @brief Simulated time since the construction of this simulator.
+		 *
+		 * Kept in double precision: in single precision, adding a small
+		 * time step to a large simulated time does not change it.
+		 */
+		double sim_time;
 		/**
 		 * @brief Viscous drag coefficient.
 		 *
@@ -205,6 +305,83 @@ class simulator {
 		 */
 		bool part_part_collisions;
 
+		/**
+		 * @brief Broad phase for collisions against sized particles.
+		 *
+		 * Partition of the sized particles used to find the candidates
+		 * to collide with a sized particle. Built at every time step
+		 * when collisions between particles are activated. See
+		 * @ref update_partcoll_sized.
+		 */
+		structures::hash_grid sized_grid;
+		/**
+		 * @brief Broad phase for collisions against agent particles.
+		 *
+		 * See @ref sized_grid.
+		 */
+		structures::hash_grid agent_grid;
+		/// Candidates to collide with a particle. Auxiliary memory.
+		std::vector<size_t> coll_cands;
+		/**
+		 * @brief Neighbourhoods of the agent particles.
+		 *
+		 * Partition of the agent particles used to find the agents near
+		 * an agent, for the steering behaviours that depend on other
+		 * agents (see @ref particles::agent_particle::needs_neighbours).
+		 * Built at every time step, see @ref make_steering_grid.
+		 */
+		structures::hash_grid steer_grid;
+		/// Agents near an agent particle. Auxiliary memory.
+		std::vector<size_t> steer_cands;
+		/**
+		 * @brief Obstacles near the agent particles.
+		 *
+		 * Objects of @ref scene_fixed near every region of the scene, for
+		 * the collision avoidance behaviour of the agents. Built only when
+		 * the fixed geometry or the largest collision avoidance distance
+		 * of the agents change, see @ref make_obstacle_grid.
+		 */
+		structures::obstacle_grid obst_grid;
+		/**
+		 * @brief Distance used to build @ref obst_grid.
+		 *
+		 * Negative when the grid has to be rebuilt.
+		 */
+		float obst_distance;
+		/// Obstacles near an agent particle. Auxiliary memory.
+		std::vector<size_t> obst_cands;
+
+		/**
+		 * @brief State of a particle between the stages of a solver.
+		 *
+		 * See @ref solver_type.
+		 */
+		struct stage_state {
+			/// Position at the beginning of the time step.
+			math::vec3 pos;
+			/// Velocity at the beginning of the time step.
+			math::vec3 vel;
+			/**
+			 * @brief Accumulated position.
+			 *
+			 * After the last stage, the predicted position.
+			 */
+			math::vec3 sum_pos;
+			/**
+			 * @brief Accumulated velocity.
+			 *
+			 * After the last stage, the predicted velocity.
+			 */
+			math::vec3 sum_vel;
+		};
+		/**
+		 * @brief State of the particles of a mesh or a fluid between stages.
+		 *
+		 * Indexed by the particles' index (see @ref particles::base_particle::index),
+		 * since a fluid may reorder its particles when computing its forces.
+		 */
+		std::vector<stage_state> stages;
+
 	private:
 
 		/**
@@ -243,48 +420,219 @@ class simulator {
 		 */
 		void init_fluid(fluids::fluid *f);
 
+		/// Builds @ref geom_tree, and clears @ref geom_tree_dirty.
+		void make_geometry_tree();
+
+		/**
+		 * @brief Computes the adaptive time step.
+		 *
+		 * The time step is the smallest of the following, scaled by
+		 * @ref cfl, and clamped to [@ref min_dt, @ref max_dt]:
+		 * - for every sized and agent particle, the time its radius
+		 * takes to be travelled at its speed, so that collisions are
+		 * not missed;
+		 * - for every fluid, the time the neighbourhood size takes to be
+		 * travelled at the largest speed of its particles plus the speed
+		 * of sound;
+		 * - for every mesh integrated explicitly, the largest stable time
+		 * step of its springs (see @ref meshes::mesh::compute_stable_time_step).
+		 * Meshes integrated implicitly or simulated with position-based
+		 * dynamics are stable with any time step.
+		 * @returns Returns the time step for the next step.
+		 */
+		float compute_time_step();
+
+		/**
+		 * @brief Applies a time step of length @ref dt.
+		 *
+		 * Updates the force fields with the free particles (see
+		 * @ref fields::field::update) and calls the following functions:
+		 * - @ref simulate_sized_particles(size_t)
+		 * - @ref simulate_agent_particles(size_t)
+		 * - @ref simulate_free_particles(size_t)
+		 * - @ref simulate_meshes(size_t)
+		 * - @ref simulate_fluids(size_t)
+		 * and updates @ref sim_time.
+		 * @param n Number of threads.
+		 */
+		void _apply_time_step(size_t n);
+
+		/**
+		 * @brief Simulate free particles that can not collide
+		 * with other particles.
+		 *
+		 * Applies a time step on all the free particles of the
+		 * simulation when they can be simulated in parallel (see
+		 * @ref free_particles_parallel). The forces are computed first,
+		 * and then all particles are moved in blocks (see
+		 * @ref apply_solver(P*,const char*,size_t,size_t)).
+		 *
+		 * Then, if there is geometry in the scene, the state reached by
+		 * every particle is used as its prediction, and the collisions
+		 * are resolved one particle at a time (see
+		 * @ref find_update_geomcoll_free).
+		 * @param n Number of threads.
+		 */
+		template<solver_type S> void _simulate_free_particles_block(size_t n);
 		/**
 		 * @brief Simulate free particles.
 		 *
 		 * Applies a time step on all the free particles of
 		 * the simulation.
 		 */
+		template<solver_type S> void _simulate_free_particles();
+		/**
+		 * @brief Calls the instance of @ref _simulate_free_particles()
+		 * for the solver in @ref solver.
+		 */
 		void _simulate_free_particles();
+		/**
+		 * @brief Simulate free particles.
+		 *
+		 * Applies a time step on all the free particles of
+		 * the simulation.
+		 *
+		 * Multithreaded execution, unless collisions between
+		 * particles have to be computed (see @ref free_particles_parallel).
+		 * The particles that die are reset sequentially after all
+		 * particles have been simulated.
+		 * @param n Number of threads.
+		 */
+		template<solver_type S> void _simulate_free_particles(size_t n);
+		/**
+		 * @brief Calls the instance of @ref _simulate_free_particles(size_t)
+		 * for the solver in @ref solver.
+		 * @param n Number of threads.
+		 */
+		void _simulate_free_particles(size_t n);
+		/// Calls @ref _simulate_sized_particles(size_t) with a single thread.
+		void _simulate_sized_particles();
 		/**
 		 * @brief Simulate sized particles.
 		 *
 		 * Applies a time step on all the sized particles of
 		 * the simulation.
+		 *
+		 * Multithreaded execution. The particles that die are reset
+		 * sequentially. The forces of the force fields are computed on
+		 * blocks of particles (see @ref compute_forces(P*,const char*,size_t,size_t)),
+		 * and then the particles are moved and collided with geometry
+		 * in parallel. Collisions between particles are computed
+		 * sequentially after all particles have been moved (see
+		 * @ref update_partcoll_sized), since they modify both
+		 * particles involved.
+		 * @param n Number of threads.
 		 */
-		void _simulate_sized_particles();
+		template<solver_type S> void _simulate_sized_particles(size_t n);
+		/**
+		 * @brief Calls the instance of @ref _simulate_sized_particles(size_t)
+		 * for the solver in @ref solver.
+		 * @param n Number of threads.
+		 */
+		void _simulate_sized_particles(size_t n);
 		/**
 		 * @brief Simulate agent particles.
 		 *
 		 * Applies a time step on all the agent particles of
 		 * the simulation.
+		 *
+		 * Collisions between particles are computed after all
+		 * agents have been moved (see @ref update_partcoll_agent).
 		 */
 		void _simulate_agent_particles();
+		/**
+		 * @brief Simulate agent particles.
+		 *
+		 * Applies a time step on all the agent particles of
+		 * the simulation.
+		 *
+		 * Multithreaded execution. The steering forces are computed
+		 * in parallel, with a dynamic schedule since the cost of each
+		 * agent depends on its behaviours and its neighbourhood. Then,
+		 * the agents are moved and collided with geometry in parallel.
+		 * Collisions between particles are computed sequentially, since
+		 * they modify both particles involved.
+		 * @param n Number of threads.
+		 */
+		void _simulate_agent_particles(size_t n);
+		/**
+		 * @brief Builds @ref steer_grid.
+		 *
+		 * The cells are as large as the largest neighbourhood distance
+		 * of the agents (see @ref particles::agent_particle::get_neighbourhood_distance)
+		 * plus the largest radius, so that the agents affecting an agent
+		 * are in the cells surrounding it.
+		 * @returns Returns whether some agent needs its neighbours. If
+		 * none does, the grid is not built.
+		 */
+		bool make_steering_grid();
+		/**
+		 * @brief Builds @ref obst_grid, if needed.
+		 *
+		 * The distance of the grid is the largest collision avoidance
+		 * distance (see @ref particles::agent_particle::coll_distance)
+		 * of the agents that avoid obstacles. The grid is rebuilt only
+		 * when this distance or the fixed geometry change.
+		 * @returns Returns whether some agent avoids obstacles and there
+		 * is fixed geometry. Otherwise, the grid is not built.
+		 */
+		bool make_obstacle_grid();
 
 		/**
-		 * @brief Simulate meshes.
+		 * @brief Predicts the next state of the particles of a mesh
+		 * integrated implicitly.
 		 *
-		 * Applies a time step on all the particles that make
-		 * up the meshes of the simulation.
+		 * Computes the forces of the particles (internal forces and
+		 * those of the force fields) and solves a step of implicit
+		 * Euler (see @ref meshes::mesh::solve_implicit). After this,
+		 * @ref stages contains the predicted position and velocity of
+		 * every particle that has to be moved.
+		 * @param m Mesh integrated implicitly.
+		 * @param move Particles to be moved.
+		 * @param n Number of threads.
+		 */
+		void predict_implicit_mesh(meshes::mesh *m, const char *move, size_t n);
+		/**
+		 * @brief Predicts the next state of the particles of a mesh
+		 * simulated with position-based dynamics.
 		 *
-		 * The forces due to the presence of force fields are
-		 * computed after the internal forces.
+		 * Moves the particles with the forces of the force fields
+		 * (with semi-implicit Euler) and projects their positions onto
+		 * the constraints of the mesh (see @ref meshes::mesh::solve_constraints).
+		 * After this, @ref stages contains the predicted position and
+		 * velocity of every particle that has to be moved.
+		 * @param m Mesh simulated with position-based dynamics.
+		 * @param move Particles to be moved.
+		 * @param n Number of threads.
 		 */
+		void predict_position_based_mesh(meshes::mesh *m, const char *move, size_t n);
+		/// Calls @ref _simulate_meshes(size_t) with a single thread.
 		void _simulate_meshes();
-
 		/**
-		 * @brief Simulate fluids.
+		 * @brief Simulate meshes.
 		 *
 		 * Applies a time step on all the particles that make
-		 * up the fluids of the simulation.
+		 * up the meshes of the simulation.
 		 *
 		 * The forces due to the presence of force fields are
-		 * computed after the internal forces.
+		 * computed after the internal forces, on blocks of particles.
+		 * The next state of all the particles is predicted first, and
+		 * then the collisions with the geometry are resolved one
+		 * particle at a time from the predicted state.
+		 *
+		 * Multithreaded execution, unless collisions between
+		 * particles have to be computed (see @ref free_particles_parallel).
+		 * @param n Number of threads.
+		 */
+		template<solver_type S> void _simulate_meshes(size_t n);
+		/**
+		 * @brief Calls the instance of @ref _simulate_meshes(size_t)
+		 * for the solver in @ref solver.
+		 * @param n Number of threads.
 		 */
+		void _simulate_meshes(size_t n);
+
+		/// Calls @ref _simulate_fluids(size_t) with a single thread.
 		void _simulate_fluids();
 		/**
 		 * @brief Simulate fluids.
@@ -293,21 +641,168 @@ class simulator {
 		 * up the fluids of the simulation.
 		 *
 		 * The forces due to the presence of force fields are
-		 * computed after the internal forces.
+		 * computed after the internal forces, on blocks of particles.
+		 * The next state of all the particles is predicted first, and
+		 * then the collisions with the geometry are resolved one
+		 * particle at a time from the predicted state.
 		 *
-		 * Multithreaded execution.
+		 * Multithreaded execution, unless collisions between
+		 * particles have to be computed (see @ref free_particles_parallel).
+		 * @param n Number of threads.
+		 */
+		template<solver_type S> void _simulate_fluids(size_t n);
+		/**
+		 * @brief Calls the instance of @ref _simulate_fluids(size_t)
+		 * for the solver in @ref solver.
 		 * @param n Number of threads.
 		 */
 		void _simulate_fluids(size_t n);
 
+		/**
+		 * @brief Can free particles be simulated in parallel?
+		 *
+		 * Free particles (and mesh and fluid particles, which are
+		 * simulated as free particles) modify the sized and agent
+		 * particles they collide with. Therefore, they can not be
+		 * simulated in parallel when collisions between particles
+		 * are activated and there are sized or agent particles.
+		 */
+		bool free_particles_parallel() const;
+		/**
+		 * @brief Can free particles collide with something?
+		 *
+		 * Free particles (and mesh and fluid particles) can collide
+		 * with the geometry of the scene and, when collisions between
+		 * particles are activated, with sized and agent particles.
+		 * When they can not collide, the solver is applied on blocks
+		 * of particles (see @ref apply_solver(P*,size_t)).
+		 */
+		bool free_particles_collide() const;
+
 		/**
 		 * @brief Predicts a particle's next position and velocity.
+		 *
+		 * The solver is a template parameter so that each simulation
+		 * loop is compiled once per solver, with the solver inlined,
+		 * instead of choosing the solver for every particle.
+		 *
+		 * The stages of the solver, if any, are applied on a copy of
+		 * the particle, evaluating only the forces of the force fields.
 		 * @param p Particle to apply the solver on.
 		 * @param[out] pos The predicted position.
 		 * @param[out] vel The predicted velocity.
+		 * @tparam S Solver applied (see @ref solver).
 		 */
-		template<class P> void apply_solver
+		template<solver_type S, class P> void apply_solver
 		(const P& p, math::vec3& pos, math::vec3& vel);
+		/**
+		 * @brief Predicts a particle's next position and velocity.
+		 *
+		 * Same as @ref apply_solver(const P&,math::vec3&,math::vec3&)
+		 * with time step @e dt, for solvers without stages.
+		 * @param p Particle to apply the solver on.
+		 * @param dt Time step.
+		 * @param[out] pos The predicted position.
+		 * @param[out] vel The predicted velocity.
+		 * @tparam S Solver applied (see @ref solver).
+		 */
+		template<solver_type S, class P> static void apply_solver
+		(const P& p, float dt, math::vec3& pos, math::vec3& vel);
+		/**
+		 * @brief Moves a block of particles.
+		 *
+		 * Applies the solver on the particles @e ps[0], ...,
+		 * @e ps[N-1], and moves them to the predicted position
+		 * and velocity. Collisions are not checked. The loop does
+		 * not branch, so it is vectorised.
+		 * @param ps Contiguous particles to be moved.
+		 * @param N Number of particles.
+		 * @tparam S Solver applied (see @ref solver).
+		 */
+		template<solver_type S, class P> void apply_solver(P *ps, size_t N);
+
+		/// Does solver @e S have stages? (see @ref solver_type).
+		template<solver_type S> static constexpr bool multistage();
+		/// Number of force evaluations of solver @e S.
+		template<solver_type S> static constexpr size_t n_stages();
+		/**
+		 * @brief Starts the stages of solver @e S on a particle.
+		 *
+		 * Saves the particle's position and velocity in @e st, and
+		 * moves the particle to the state where the forces of the
+		 * first stage are evaluated.
+		 * @param[out] p Particle.
+		 * @param[out] st State of the particle between stages.
+		 * @param dt Time step.
+		 */
+		template<solver_type S, class P> static void begin_stages
+		(P& p, stage_state& st, float dt);
+		/**
+		 * @brief Applies a stage of solver @e S on a particle.
+		 *
+		 * The force of the particle is the one at its current
+		 * state. The particle is moved to the state of the next
+		 * stage. After the last stage, the particle is moved back
+		 * to its initial state and the predicted position and
+		 * velocity are stored in @e st.
+		 * @param s Index of the stage.
+		 * @param[out] p Particle.
+		 * @param[out] st State of the particle between stages.
+		 * @param dt Time step.
+		 */
+		template<solver_type S, class P> static void apply_stage
+		(size_t s, P& p, stage_state& st, float dt);
+		/**
+		 * @brief Applies all stages of solver @e S on a block of particles.
+		 *
+		 * At every stage, the forces are cleared, the internal forces
+		 * are computed with @e internal, and then the forces of the
+		 * force fields are added. After this, @ref stages contains
+		 * the predicted position and velocity of every particle that
+		 * has to be moved. The other particles do not move in any stage.
+		 * @param ps Contiguous particles, with indices in [0,@e N).
+		 * @param move Particles to be moved. If it is null, all
+		 * particles are moved. Must be null if @e internal
+		 * reorders the particles.
+		 * @param N Number of particles.
+		 * @param internal Computes the internal forces of the
+		 * particles (those of a mesh or a fluid).
+		 * @param n Number of threads.
+		 */
+		template<solver_type S, class P, class F> void apply_stages
+		(P *ps, const char *move, size_t N, const F& internal, size_t n);
+		/**
+		 * @brief Moves some particles of a block.
+		 *
+		 * Moves the particles @e ps[i] such that @e move[i] is not 0,
+		 * in the same way as @ref apply_solver(P*,size_t). The block
+		 * is split into runs of consecutive particles that have to be
+		 * moved.
+		 * @param ps Contiguous particles.
+		 * @param move Particles to be moved. If it is null, all
+		 * particles are moved.
+		 * @param N Number of particles.
+		 * @param n Number of threads.
+		 * @tparam S Solver applied (see @ref solver).
+		 */
+		template<solver_type S, class P> void apply_solver
+		(P *ps, const char *move, size_t N, size_t n);
+		/**
+		 * @brief Predicts the next state of a block of particles.
+		 *
+		 * Same as @ref apply_solver(P*,const char*,size_t,size_t), but
+		 * the particles are not moved: after this, @ref stages contains
+		 * the predicted position and velocity of every particle that
+		 * has to be moved. Only for solvers without stages.
+		 * @param ps Contiguous particles, with indices in [0,@e N).
+		 * @param move Particles to be moved. If it is null, all
+		 * particles are moved.
+		 * @param N Number of particles.
+		 * @param n Number of threads.
+		 * @tparam S Solver applied (see @ref solver).
+		 */
+		template<solver_type S, class P> void predict_solver
+		(P *ps, const char *move, size_t N, size_t n);
 
 		/**
 		 * @brief Computes the forces acting in the simulation.
@@ -321,6 +816,23 @@ class simulator {
 		 * @param[out] p The particle whose force attribute is to be modified.
 		 */
 		template<class P> void compute_forces(P& p);
+		/**
+		 * @brief Computes the forces acting in the simulation on a block
+		 * of particles.
+		 *
+		 * Same as @ref compute_forces(P&) on the particles @e ps[i] such
+		 * that @e move[i] is not 0. The particles are split into batches
+		 * and every force field computes its forces on a whole batch (see
+		 * @ref fields::field::compute_forces), instead of on a single
+		 * particle at a time.
+		 * @param[out] ps Contiguous particles.
+		 * @param move Particles whose force is computed. If it is null,
+		 * the forces on all particles are computed.
+		 * @param N Number of particles.
+		 * @param n Number of threads.
+		 */
+		template<class P> void compute_forces
+		(P *ps, const char *move, size_t N, size_t n);
 
 		/**
 		 * @brief Update a free particle that may collide with geometry.
@@ -383,32 +895,81 @@ class simulator {
 		 * @brief Update a sized particle that may collide with a sized
 		 * or an agent particle.
 		 *
-		 * When checking collisions with sized particles, the @e i-th particle
-		 * is ignored.
+		 * When checking collisions with sized particles, only those
+		 * with an index larger than @e i are considered.
+		 *
+		 * The particles that may collide with @e p are retrieved from
+		 * @ref sized_grid and @ref agent_grid, and checked in increasing
+		 * order of index.
 		 *
 		 * @param[in] p Current state of particle to be updated.
 		 * @param[in] i Index of the sized particle to ignore.
 		 * @pre This method is called after finding a definitive state of a
 		 * particle after colliding with geometry.
+		 * @pre The grids have been built (see @ref update_partcoll_sized).
 		 */
 		void find_update_partcoll_sized
 		(particles::sized_particle& p, size_t i);
 
+		/**
+		 * @brief Collides the sized particles with sized and agent particles.
+		 *
+		 * Builds the broad phase (see @ref sized_grid, @ref agent_grid)
+		 * and calls @ref find_update_partcoll_sized for every sized
+		 * particle moved in this time step, in increasing order of index.
+		 *
+		 * The cells of the grids leave room for the displacement of
+		 * the particles due to the collisions resolved earlier in the
+		 * same pass (see @ref make_partcoll_grids).
+		 * @param moved The @e i-th sized particle has been moved in this
+		 * time step if, and only if, moved[i] equals 1.
+		 */
+		void update_partcoll_sized(const std::vector<char>& moved);
+
+		/**
+		 * @brief Builds @ref sized_grid and @ref agent_grid.
+		 *
+		 * The side of the cells of the grids is the largest distance
+		 * between two colliding particles, twice the largest radius
+		 * @e R, plus the largest displacement of a particle due to a
+		 * collision: the largest of 2*@e R and 2*@e v*@ref dt, where
+		 * @e v is the largest speed of the sized and agent particles.
+		 * This bound assumes that the particles did not overlap at the
+		 * beginning of the step and that each particle is pushed once.
+		 */
+		void make_partcoll_grids();
+
 		/**
 		 * @brief Update an agent particle that may collide with a sized or an
 		 * agent particle.
 		 *
-		 * When checking collisions with agent particles, the @e i-th particle
-		 * is ignored.
+		 * When checking collisions with agent particles, only those
+		 * with an index larger than @e i are considered.
+		 *
+		 * The particles that may collide with @e p are retrieved from
+		 * @ref sized_grid and @ref agent_grid, and checked in increasing
+		 * order of index.
 		 *
 		 * @param[in] p Current state of particle to be updated.
-		 * @param[in] i Index of the sized particle to ignore.
+		 * @param[in] i Index of the agent particle to ignore.
 		 * @pre This method is called after finding a definitive state of a
 		 * particle after colliding with geometry.
+		 * @pre The grids have been built (see @ref update_partcoll_agent).
 		 */
 		void find_update_partcoll_agent
 		(particles::agent_particle& p, size_t i);
 
+		/**
+		 * @brief Collides the agent particles with sized and agent particles.
+		 *
+		 * Builds the broad phase (see @ref make_partcoll_grids) and calls
+		 * @ref find_update_partcoll_agent for every agent particle moved
+		 * in this time step, in increasing order of index.
+		 * @param moved The @e i-th agent particle has been moved in this
+		 * time step if, and only if, moved[i] equals 1.
+		 */
+		void update_partcoll_agent(const std::vector<char>& moved);
+
 	public:
 		/**
 		 * @brief Default constructor.
@@ -545,13 +1106,27 @@ class simulator {
 		/**
 		 * @brief Adds a geometrical object to the scene.
 		 *
-		 * The geometrical object is added to @ref scene_fixed.
+		 * The geometrical object is added to @ref scene_fixed, and
+		 * @ref geom_tree is rebuilt before the particles are simulated
+		 * next. The geometry is assumed not to move: if an object is
+		 * modified afterwards (for example, with
+		 * @ref geometric::geometry::set_position), function
+		 * @ref update_geometry must be called.
 		 *
 		 * The caller should not free the object since the simulator
 		 * will take care of that.
 		 * @param g A non-null pointer to the object.
 		 */
 		size_t add_geometry(geometric::geometry *g);
+		/**
+		 * @brief Notifies that the fixed geometry has been modified.
+		 *
+		 * The structures built over the objects in @ref scene_fixed
+		 * (@ref geom_tree, @ref obst_grid) are rebuilt before the
+		 * particles are simulated next. Must be called after moving or
+		 * resizing any object added with @ref add_geometry.
+		 */
+		void update_geometry();
 		/**
 		 * @brief Deletes all geometry in this simulator.
 		 *
@@ -669,6 +1244,17 @@ class simulator {
 		 * are checked.
 		 */
 		void simulate_free_particles();
+		/**
+		 * @brief Simulate free particles.
+		 *
+		 * See @ref simulate_free_particles().
+		 *
+		 * @param nt Number of threads. If it equals 1, calls
+		 * @ref _simulate_free_particles(). If it is greater then it calls
+		 * @ref _simulate_free_particles(size_t).
+		 * @pre @e nt > 0.
+		 */
+		void simulate_free_particles(size_t nt);
 		/**
 		 * @brief Simulate sized particles.
 		 *
@@ -683,6 +1269,17 @@ class simulator {
 		 * are checked.
 		 */
 		void simulate_sized_particles();
+		/**
+		 * @brief Simulate sized particles.
+		 *
+		 * See @ref simulate_sized_particles().
+		 *
+		 * @param nt Number of threads. If it equals 1, calls
+		 * @ref _simulate_sized_particles(). If it is greater then it calls
+		 * @ref _simulate_sized_particles(size_t).
+		 * @pre @e nt > 0.
+		 */
+		void simulate_sized_particles(size_t nt);
 		/**
 		 * @brief Simulate agent particles.
 		 *
@@ -696,6 +1293,17 @@ class simulator {
 		 * particles.
 		 */
 		void simulate_agent_particles();
+		/**
+		 * @brief Simulate agent particles.
+		 *
+		 * See @ref simulate_agent_particles().
+		 *
+		 * @param nt Number of threads. If it equals 1, calls
+		 * @ref _simulate_agent_particles(). If it is greater then it calls
+		 * @ref _simulate_agent_particles(size_t).
+		 * @pre @e nt > 0.
+		 */
+		void simulate_agent_particles(size_t nt);
 
 		/**
 		 * @brief Simulate meshes.
@@ -709,6 +1317,17 @@ class simulator {
 		 * accordingly.
 		 */
 		void simulate_meshes();
+		/**
+		 * @brief Simulate meshes.
+		 *
+		 * See @ref simulate_meshes().
+		 *
+		 * @param nt Number of threads. If it equals 1, calls
+		 * @ref _simulate_meshes(). If it is greater then it calls
+		 * @ref _simulate_meshes(size_t).
+		 * @pre @e nt > 0.
+		 */
+		void simulate_meshes(size_t nt);
 
 		/**
 		 * @brief Simulate fluids.
@@ -745,21 +1364,44 @@ class simulator {
 		 * - @ref simulate_fluids()
 		 * Parameter @e dt (set via method @ref set_time_step(float))
 		 * indicates how much time has passed since the last time step.
+		 * If the time step is adaptive (see @ref set_adaptive_time_step),
+		 * it is computed before the step (see @ref compute_time_step).
 		 */
 		void apply_time_step();
 		/**
 		 * @brief Apply a time step to the simulation.
 		 *
 		 * Calls the following functions:
-		 * - @ref simulate_sized_particles()
-		 * - @ref simulate_agent_particles()
-		 * - @ref simulate_free_particles()
-		 * - @ref simulate_meshes()
+		 * - @ref simulate_sized_particles(size_t)
+		 * - @ref simulate_agent_particles(size_t)
+		 * - @ref simulate_free_particles(size_t)
+		 * - @ref simulate_meshes(size_t)
 		 * - @ref simulate_fluids(size_t)
 		 * Parameter @e dt (set via method @ref set_time_step(float))
 		 * indicates how much time has passed since the last time step.
+		 * If the time step is adaptive (see @ref set_adaptive_time_step),
+		 * it is computed before the step (see @ref compute_time_step).
+		 * @param n Number of threads.
 		 */
 		void apply_time_step(size_t n);
+		/**
+		 * @brief Applies time steps until a given simulated time.
+		 *
+		 * Applies as many time steps as needed so that the simulated
+		 * time (see @ref get_simulated_time) becomes @e t. The time
+		 * steps are fixed or adaptive (see @ref set_adaptive_time_step)
+		 * except for the last one, which is shortened to end exactly at
+		 * @e t. The fixed time step is not modified.
+		 *
+		 * Verlet (see @ref solver_type::Verlet) assumes a constant time
+		 * step, so it should not be used with steps of varying length.
+		 *
+		 * If a time step is too small to advance the simulated time,
+		 * an error is printed and the simulation stops before @e t.
+		 * @param t Target simulated time.
+		 * @param n Number of threads.
+		 */
+		void simulate_until(float t, size_t n = 1);
 
 		// SETTERS
 
@@ -769,6 +1411,30 @@ class simulator {
 		 */
 		void set_time_step(float t);
 
+		/**
+		 * @brief Activates/Deactivates the adaptive time step.
+		 *
+		 * See @ref adaptive_dt. Verlet (see @ref solver_type::Verlet)
+		 * assumes a constant time step, so it should not be used with
+		 * an adaptive time step.
+		 * @param a True or false depending on whether the time step
+		 * has to be chosen at every step.
+		 */
+		void set_adaptive_time_step(bool a = true);
+		/**
+		 * @brief Sets the bounds of the adaptive time step.
+		 * @param m Minimum time step (see @ref min_dt).
+		 * @param M Maximum time step (see @ref max_dt).
+		 * @pre 0 < @e m <= @e M.
+		 */
+		void set_time_step_bounds(float m, float M);
+		/**
+		 * @brief Sets the Courant number of the adaptive time step.
+		 * @param c See @ref cfl.
+		 * @pre @e c > 0.
+		 */
+		void set_cfl_number(float c);
+
 		/**
 		 * @brief Sets the viscous drag coefficient.
 		 * @param d Positive floating-point value.
@@ -903,6 +1569,16 @@ class simulator {
 
 		/// Returns the time step of the simulation (see @ref dt).
 		float get_time_step() const;
+		/// Returns whether the time step is adaptive (see @ref adaptive_dt).
+		bool is_time_step_adaptive() const;
+		/// Returns the minimum adaptive time step (see @ref min_dt).
+		float get_min_time_step() const;
+		/// Returns the maximum adaptive time step (see @ref max_dt).
+		float get_max_time_step() const;
+		/// Returns the Courant number of the adaptive time step (see @ref cfl).
+		float get_cfl_number() const;
+		/// Returns the simulated time (see @ref sim_time).
+		double get_simulated_time() const;
 
 		/**
 		 * @brief Are collisions between particles activated?
@@ -0,0 +1,207 @@
+/*********************************************************************
+ * Real-time physics simulation project
+ * Copyright (C) 2018-2019 Lluís Alemany Puig
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Contact: Lluís Alemany Puig (lluis.alemany.puig@gmail.com)
+ * 
+ ********************************************************************/
+
+#include <physim/structures/bvh.hpp>
+
+// C includes
+#include <assert.h>
+
+// C++ includes
+#include <algorithm>
+#include <limits>
+using namespace std;
+
+// physim includes
+#include <physim/math/private/math3/base.hpp>
+#include <physim/math/private/math3/comparison.hpp>
+
+// boxes [m1,M1] and [m2,M2] overlap
+#define boxes_overlap(m1,M1, m2,M2)						\
+	((m1).x <= (M2).x and (m2).x <= (M1).x and			\
+	 (m1).y <= (M2).y and (m2).y <= (M1).y and			\
+	 (m1).z <= (M2).z and (m2).z <= (M1).z)
+
+namespace physim {
+using namespace math;
+
+namespace structures {
+
+// PRIVATE
+
+void bvh::make_bvh(
+	const vector<vec3>& mins, const vector<vec3>& maxs,
+	size_t n_idx, size_t b, size_t e, size_t leaf_size
+)
+{
+	// bounding box of the boxes, and of their centres
+	static const float inf = numeric_limits<float>::max();
+	vec3 vmin(inf), vmax(-inf);
+	vec3 cmin(inf), cmax(-inf);
+	for (size_t k = b; k < e; ++k) {
+		const size_t i = idxs[k];
+		__pm3_min2(vmin, vmin, mins[i]);
+		__pm3_max2(vmax, vmax, maxs[i]);
+
+		vec3 c = (mins[i] + maxs[i])/2.0f;
+		__pm3_min2(cmin, cmin, c);
+		__pm3_max2(cmax, cmax, c);
+	}
+	__pm3_assign_v(nodes[n_idx].vmin, vmin);
+	__pm3_assign_v(nodes[n_idx].vmax, vmax);
+
+	if (e - b <= leaf_size) {
+		nodes[n_idx].first = b;
+		nodes[n_idx].count = e - b;
+		return;
+	}
+
+	// split at the median along the longest axis
+	vec3 ext = cmax - cmin;
+	int axis = 0;
+	if (ext.y > ext.x) {
+		axis = 1;
+	}
+	if (ext.z > (axis == 0 ? ext.x : ext.y)) {
+		axis = 2;
+	}
+
+	auto centre =
+	[&](size_t i) -> float {
+		return (axis == 0 ? mins[i].x + maxs[i].x :
+			   (axis == 1 ? mins[i].y + maxs[i].y : mins[i].z + maxs[i].z));
+	};
+
+	const size_t m = b + (e - b)/2;
+	nth_element(
+		idxs.begin() + b, idxs.begin() + m, idxs.begin() + e,
+		[&](size_t i, size_t j) -> bool { return centre(i) < centre(j); }
+	);
+
+	// the children are allocated contiguously
+	const size_t left = nodes.size();
+	nodes.resize(nodes.size() + 2);
+	nodes[n_idx].first = left;
+	nodes[n_idx].count = 0;
+
+	make_bvh(mins, maxs, left, b, m, leaf_size);
+	make_bvh(mins, maxs, left + 1, m, e, leaf_size);
+}
+
+// PUBLIC
+
+bvh::bvh() { }
+
+bvh::~bvh() {
+	clear();
+}
+
+// MEMORY
+
+void bvh::init(
+	const vector<vec3>& mins, const vector<vec3>& maxs,
+	size_t leaf_size
+)
+{
+	assert(mins.size() == maxs.size());
+	assert(leaf_size > 0);
+
+	nodes.clear();
+	idxs.clear();
+	unbounded.clear();
+
+	for (size_t i = 0; i < mins.size(); ++i) {
+		if (mins[i].x > maxs[i].x or
+			mins[i].y > maxs[i].y or
+			mins[i].z > maxs[i].z)
+		{
+			unbounded.push_back(i);
+		}
+		else {
+			idxs.push_back(i);
+		}
+	}
+
+	if (idxs.size() > 0) {
+		nodes.resize(1);
+		make_bvh(mins, maxs, 0, 0, idxs.size(), leaf_size);
+	}
+}
+
+void bvh::clear() {
+	nodes.clear();
+	idxs.clear();
+	unbounded.clear();
+	nodes.shrink_to_fit();
+	idxs.shrink_to_fit();
+	unbounded.shrink_to_fit();
+}
+
+// GETTERS
+
+size_t bvh::get_indices
+(const vec3& qmin, const vec3& qmax, size_t *res, size_t n) const
+{
+	size_t k = 0;
+	auto store =
+	[&](size_t i) -> void {
+		if (k < n) {
+			res[k] = i;
+		}
+		++k;
+	};
+
+	for (size_t i : unbounded) {
+		store(i);
+	}
+
+	if (nodes.size() == 0) {
+		return k;
+	}
+
+	// The tree is split at the median, so its depth is
+	// logarithmic in the number of boxes: a stack of 64
+	// nodes is more than enough.
+	size_t stack[64];
+	size_t top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const node& nd = nodes[stack[--top]];
+		if (not boxes_overlap(nd.vmin,nd.vmax, qmin,qmax)) {
+			continue;
+		}
+
+		if (nd.count > 0) {
+			for (size_t j = nd.first; j < nd.first + nd.count; ++j) {
+				store(idxs[j]);
+			}
+		}
+		else {
+			stack[top++] = nd.first + 1;
+			stack[top++] = nd.first;
+		}
+	}
+
+	return k;
+}
+
+} // -- namespace structures
+} // -- namespace physim
@@ -0,0 +1,148 @@
+/*********************************************************************
+ * Real-time physics simulation project
+ * Copyright (C) 2018-2019 Lluís Alemany Puig
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Contact: Lluís Alemany Puig (lluis.alemany.puig@gmail.com)
+ * 
+ ********************************************************************/
+
+#pragma once
+
+// C includes
+#include <stddef.h>
+
+// C++ includes
+#include <vector>
+
+// physim includes
+#include <physim/math/vec3.hpp>
+
+namespace physim {
+namespace structures {
+
+/**
+ * @brief Bounding volume hierarchy.
+ *
+ * Binary tree of axis-aligned bounding boxes built over a set of
+ * boxes (see @ref init). Every node stores the bounding box of the
+ * boxes below it, so that the boxes overlapping a query box are
+ * found without testing all of them (see @ref get_indices).
+ *
+ * The tree is built top-down: the boxes of a node are split at the
+ * median of their centres along the longest axis of the node.
+ *
+ * Boxes whose minimum is larger than their maximum in some axis
+ * (for example, the default box of unbounded geometry like planes)
+ * are considered unbounded: they are not stored in the tree and
+ * are reported by every query.
+ */
+class bvh {
+	private:
+		/// BVH's node definition.
+		struct node {
+			/// Points with the minimum coordinate values of the boxes within.
+			math::vec3 vmin;
+			/// Points with the maximum coordinate values of the boxes within.
+			math::vec3 vmax;
+			/**
+			 * @brief First index.
+			 *
+			 * In a leaf, position in @ref idxs of the first box.
+			 * Otherwise, position in @ref nodes of the first child.
+			 * The second child is next to the first.
+			 */
+			size_t first;
+			/// Number of boxes in a leaf. 0 for the other nodes.
+			size_t count;
+		};
+
+		/// Nodes of the tree. The root is the first node.
+		std::vector<node> nodes;
+		/// Indices of the bounded boxes, grouped by leaf.
+		std::vector<size_t> idxs;
+		/// Indices of the unbounded boxes.
+		std::vector<size_t> unbounded;
+
+	private:
+
+		/**
+		 * @brief Builds the subtree of the boxes in @ref idxs
+		 * in the interval [@e b, @e e).
+		 * @param mins Minimum coordinates of all boxes.
+		 * @param maxs Maximum coordinates of all boxes.
+		 * @param n Position in @ref nodes of the root of the subtree.
+		 * @param b First position in @ref idxs.
+		 * @param e Last position in @ref idxs, not included.
+		 * @param leaf_size Maximum number of boxes in a leaf.
+		 */
+		void make_bvh(
+			const std::vector<math::vec3>& mins,
+			const std::vector<math::vec3>& maxs,
+			size_t n, size_t b, size_t e, size_t leaf_size
+		);
+
+	public:
+		/// Default constructor.
+		bvh();
+		/// Destructor.
+		~bvh();
+
+		// MEMORY
+
+		/**
+		 * @brief Builds the hierarchy of a set of boxes.
+		 *
+		 * The @e i-th box has minimum coordinates @e mins[i] and
+		 * maximum coordinates @e maxs[i].
+		 * @param mins Minimum coordinates of the boxes.
+		 * @param maxs Maximum coordinates of the boxes.
+		 * @param leaf_size Maximum number of boxes in a leaf.
+		 * @pre @e mins and @e maxs have the same size.
+		 * @pre @e leaf_size > 0.
+		 */
+		void init(
+			const std::vector<math::vec3>& mins,
+			const std::vector<math::vec3>& maxs,
+			size_t leaf_size = 2
+		);
+
+		/// Frees the memory occupied by this object.
+		void clear();
+
+		// GETTERS
+
+		/**
+		 * @brief Retrieves the boxes overlapping a query box.
+		 *
+		 * The indices of the unbounded boxes are always retrieved.
+		 * The indices are retrieved in no particular order, and at
+		 * most @e n of them are stored.
+		 * @param[in] qmin Minimum coordinates of the query box.
+		 * @param[in] qmax Maximum coordinates of the query box.
+		 * @param[out] res The indices of the boxes.
+		 * @param[in] n Number of indices that fit in @e res.
+		 * @returns Returns the number of boxes overlapping the query
+		 * box. If it is larger than @e n, only the first @e n indices
+		 * have been stored.
+		 */
+		size_t get_indices(
+			const math::vec3& qmin, const math::vec3& qmax,
+			size_t *res, size_t n
+		) const;
+};
+
+} // -- namespace structures
+} // -- namespace physim
@@ -0,0 +1,201 @@
+/*********************************************************************
+ * Real-time physics simulation project
+ * Copyright (C) 2018-2019 Lluís Alemany Puig
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Contact: Lluís Alemany Puig (lluis.alemany.puig@gmail.com)
+ * 
+ ********************************************************************/
+
+#include <physim/structures/hash_grid.hpp>
+
+// C includes
+#include <assert.h>
+#include <math.h>
+
+// C++ includes
+#include <algorithm>
+#include <limits>
+using namespace std;
+
+// physim includes
+#include <physim/math/private/math3/base.hpp>
+#include <physim/math/private/math3/comparison.hpp>
+
+namespace physim {
+using namespace math;
+
+namespace structures {
+
+// PRIVATE
+
+size_t hash_grid::bucket(long long int i, long long int j, long long int k)
+const
+{
+	// the usual spatial hash function with three large primes
+	size_t h =
+		(static_cast<size_t>(i)*73856093) ^
+		(static_cast<size_t>(j)*19349663) ^
+		(static_cast<size_t>(k)*83492791);
+
+	// n_buckets is a power of 2
+	return h & (n_buckets - 1);
+}
+
+// PUBLIC
+
+hash_grid::hash_grid() {
+	cell_size = 1.0f;
+	inv_cell_size = 1.0f;
+	__pm3_assign_s(origin, 0.0f);
+	n_buckets = 1;
+	cell_start = vector<size_t>(2, 0);
+}
+
+hash_grid::~hash_grid() {
+	clear();
+}
+
+// MEMORY
+
+void hash_grid::init(const void *it, size_t n, size_t offset, float s) {
+	assert(s > 0.0f);
+
+	cell_size = s;
+	inv_cell_size = 1.0f/s;
+
+	// origin of the grid: minimum coordinates of the cloud
+	static const float inf = numeric_limits<float>::max();
+	__pm3_assign_s(origin, inf);
+
+	const char *iter = static_cast<const char *>(it);
+	for (size_t i = 0; i < n; ++i) {
+		const vec3 *v = reinterpret_cast<const vec3 *>(iter + i*offset);
+		__pm3_min2(origin, origin, *v);
+	}
+
+	// number of buckets: the smallest power of 2 that
+	// is at least twice the number of points
+	n_buckets = 1;
+	while (n_buckets < 2*n) {
+		n_buckets *= 2;
+	}
+
+	// these do not allocate memory if the size does not grow
+	cell_start.assign(n_buckets + 1, 0);
+	bucket_of.resize(n);
+	idxs.resize(n);
+
+	// 1. Count the points in every bucket. The count of
+	// bucket 'b' is stored at position b + 1.
+	for (size_t i = 0; i < n; ++i) {
+		const vec3 *v = reinterpret_cast<const vec3 *>(iter + i*offset);
+		size_t b = bucket(
+			static_cast<long long int>((v->x - origin.x)*inv_cell_size),
+			static_cast<long long int>((v->y - origin.y)*inv_cell_size),
+			static_cast<long long int>((v->z - origin.z)*inv_cell_size)
+		);
+		bucket_of[i] = b;
+		++cell_start[b + 1];
+	}
+
+	// 2. Prefix sum: first position of every bucket.
+	for (size_t b = 1; b <= n_buckets; ++b) {
+		cell_start[b] += cell_start[b - 1];
+	}
+
+	// 3. Place the indices. Use the first position of the next
+	// bucket as the insertion position of the current bucket
+	// and shift them back afterwards.
+	for (size_t i = 0; i < n; ++i) {
+		size_t b = bucket_of[i];
+		idxs[cell_start[b]] = i;
+		++cell_start[b];
+	}
+	for (size_t b = n_buckets; b > 0; --b) {
+		cell_start[b] = cell_start[b - 1];
+	}
+	cell_start[0] = 0;
+}
+
+void hash_grid::reset() {
+	n_buckets = 1;
+	cell_start.assign(2, 0);
+	idxs.clear();
+	bucket_of.clear();
+}
+
+void hash_grid::clear() {
+	reset();
+	cell_start.shrink_to_fit();
+	idxs.shrink_to_fit();
+	bucket_of.shrink_to_fit();
+}
+
+// GETTERS
+
+float hash_grid::get_cell_size() const {
+	return cell_size;
+}
+
+size_t hash_grid::get_buckets(const vec3& p, size_t *buckets) const {
+	const long long int ci =
+		static_cast<long long int>(floor((p.x - origin.x)*inv_cell_size));
+	const long long int cj =
+		static_cast<long long int>(floor((p.y - origin.y)*inv_cell_size));
+	const long long int ck =
+		static_cast<long long int>(floor((p.z - origin.z)*inv_cell_size));
+
+	size_t n = 0;
+	for (long long int i = ci - 1; i <= ci + 1; ++i) {
+	for (long long int j = cj - 1; j <= cj + 1; ++j) {
+	for (long long int k = ck - 1; k <= ck + 1; ++k) {
+		size_t b = bucket(i,j,k);
+
+		// discard empty buckets
+		if (cell_start[b] == cell_start[b + 1]) {
+			continue;
+		}
+		// discard buckets already retrieved: different
+		// cells may be mapped to the same bucket
+		if (find(buckets, buckets + n, b) != buckets + n) {
+			continue;
+		}
+		buckets[n] = b;
+		++n;
+	}
+	}
+	}
+	return n;
+}
+
+const size_t *hash_grid::begin_bucket(size_t b) const {
+	return idxs.data() + cell_start[b];
+}
+
+const size_t *hash_grid::end_bucket(size_t b) const {
+	return idxs.data() + cell_start[b + 1];
+}
+
+void hash_grid::get_indices(const vec3& p, vector<size_t>& res) const {
+	size_t buckets[27];
+	size_t nb = get_buckets(p, buckets);
+	for (size_t b = 0; b < nb; ++b) {
+		res.insert(res.end(), begin_bucket(buckets[b]), end_bucket(buckets[b]));
+	}
+}
+
+} // -- namespace structures
+} // -- namespace physim
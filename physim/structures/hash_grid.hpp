@@ -0,0 +1,157 @@
+/*********************************************************************
+ * Real-time physics simulation project
+ * Copyright (C) 2018-2019 Lluís Alemany Puig
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Contact: Lluís Alemany Puig (lluis.alemany.puig@gmail.com)
+ * 
+ ********************************************************************/
+
+#pragma once
+
+// C includes
+#include <stddef.h>
+
+// C++ includes
+#include <vector>
+
+// physim includes
+#include <physim/math/vec3.hpp>
+
+namespace physim {
+namespace structures {
+
+/**
+ * @brief Hashed uniform grid.
+ *
+ * Partition of a cloud of points into cubic cells of the same size
+ * (see @ref cell_size), also known as cell-linked list. The cells are
+ * mapped to a fixed number of buckets (see @ref n_buckets) with a
+ * spatial hash function, so that the memory used does not depend on
+ * the extent of the cloud of points.
+ *
+ * The points are sorted by bucket with a counting sort, and the
+ * indices of the points in the same bucket are stored contiguously
+ * in @ref idxs. Queries retrieve the (at most) 27 buckets of the
+ * cells surrounding a point, so that all the points within a distance
+ * @ref cell_size of it are found.
+ *
+ * Since different cells may be mapped to the same bucket, the buckets
+ * may contain points far from the query point. Therefore, the caller
+ * is expected to filter the candidates by their actual distance.
+ *
+ * The memory used by this structure is kept across calls to
+ * @ref init, so that rebuilding it at every time step of a simulation
+ * does not allocate memory as long as the number of points does not
+ * grow.
+ */
+class hash_grid {
+	private:
+		/// Length of the side of a cell.
+		float cell_size;
+		/// Inverse of @ref cell_size.
+		float inv_cell_size;
+		/// Origin of the grid.
+		math::vec3 origin;
+
+		/// Number of buckets. Always a power of 2.
+		size_t n_buckets;
+		/**
+		 * @brief First position in @ref idxs of every bucket.
+		 *
+		 * The indices of the points in the @e b-th bucket are those
+		 * in the interval [cell_start[b], cell_start[b + 1]) of
+		 * @ref idxs. This vector has @ref n_buckets + 1 elements.
+		 */
+		std::vector<size_t> cell_start;
+		/// Indices of the points, sorted by bucket.
+		std::vector<size_t> idxs;
+		/// Bucket of every point. Auxiliary memory for the sort.
+		std::vector<size_t> bucket_of;
+
+	private:
+
+		/// Returns the bucket of the cell with coordinates @e i, @e j, @e k.
+		size_t bucket(long long int i, long long int j, long long int k) const;
+
+	public:
+		/// Default constructor.
+		hash_grid();
+		/// Destructor.
+		~hash_grid();
+
+		// MEMORY
+
+		/**
+		 * @brief Builds the partition of a cloud of points.
+		 *
+		 * The cloud of points is read as in function
+		 * @ref octree::init(const void*,size_t,size_t,size_t).
+		 *
+		 * @param p Pointer to the first element in which the math::vec3 is allocated.
+		 * @param n Number of math::vec3.
+		 * @param offset Byte offset between math::vec3.
+		 * @param s Length of the side of a cell (see @ref cell_size).
+		 * @pre @e s > 0.
+		 */
+		void init(const void *p, size_t n, size_t offset, float s);
+
+		/**
+		 * @brief Clears the contents of this grid.
+		 *
+		 * The memory is not freed, see @ref clear.
+		 */
+		void reset();
+
+		/// Frees the memory occupied by this object.
+		void clear();
+
+		// GETTERS
+
+		/// Returns the length of the side of the cells.
+		float get_cell_size() const;
+
+		/**
+		 * @brief Retrieves the buckets of the cells surrounding a point.
+		 *
+		 * These are the buckets of the cell containing @e p and its 26
+		 * adjacent cells. Every bucket is retrieved once and empty
+		 * buckets are discarded.
+		 * @param[in] p Point to be located.
+		 * @param[out] buckets The buckets of the cells. Must have space
+		 * for at least 27 values.
+		 * @returns Returns the number of buckets stored in @e buckets.
+		 */
+		size_t get_buckets(const math::vec3& p, size_t *buckets) const;
+
+		/// Returns a constant pointer to the first index of bucket @e b.
+		const size_t *begin_bucket(size_t b) const;
+		/// Returns a constant pointer past the last index of bucket @e b.
+		const size_t *end_bucket(size_t b) const;
+
+		/**
+		 * @brief Retrieves the indices of the points in the cells
+		 * surrounding a point.
+		 *
+		 * See @ref get_buckets.
+		 * @param[in] p Point to be located.
+		 * @param[out] idxs The indices of the points in the buckets of the
+		 * cells surrounding @e p. The indices are appended at the end.
+		 */
+		void get_indices(const math::vec3& p, std::vector<size_t>& idxs) const;
+};
+
+} // -- namespace structures
+} // -- namespace physim
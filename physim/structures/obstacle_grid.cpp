@@ -0,0 +1,249 @@
+/*********************************************************************
+ * Real-time physics simulation project
+ * Copyright (C) 2018-2019 Lluís Alemany Puig
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Contact: Lluís Alemany Puig (lluis.alemany.puig@gmail.com)
+ * 
+ ********************************************************************/
+
+#include <physim/structures/obstacle_grid.hpp>
+
+// C includes
+#include <assert.h>
+#include <math.h>
+
+// C++ includes
+#include <algorithm>
+#include <functional>
+#include <limits>
+using namespace std;
+
+// physim includes
+#include <physim/geometry/rectangle.hpp>
+#include <physim/geometry/plane.hpp>
+#include <physim/math/private/math3.hpp>
+
+// the box of geometry 'g' is unbounded
+#define unbounded_box(g)								\
+	((g)->get_min().x > (g)->get_max().x or				\
+	 (g)->get_min().y > (g)->get_max().y or				\
+	 (g)->get_min().z > (g)->get_max().z)
+
+namespace physim {
+using namespace math;
+using namespace geometric;
+
+namespace structures {
+
+// PRIVATE
+
+bool obstacle_grid::is_near
+(const geometry *g, const vec3& c, float d, float h)
+{
+	// The distances used are 1-Lipschitz: if the object is within
+	// distance 'd' of a point at distance 'h' of 'c', then it is
+	// within distance 'd + h' of 'c'.
+	if (g->get_geom_type() == geometry_type::Rectangle) {
+		const rectangle *r = static_cast<const rectangle *>(g);
+		return std::abs(r->distance(c)) <= d + h;
+	}
+	if (g->get_geom_type() == geometry_type::Plane) {
+		const plane *p = static_cast<const plane *>(g);
+		return std::abs(p->dist_point_plane(c)) <= d + h;
+	}
+	if (unbounded_box(g)) {
+		return true;
+	}
+
+	// the object is approximated with a sphere: see
+	// agent_particle::add_collision_avoidance
+	return __pm3_dist(c, g->get_box_center()) <= sqrt(d*d + g->approx_radius()) + h;
+}
+
+bool obstacle_grid::locate(const vec3& p, size_t& c) const {
+	const float fx = (p.x - origin.x)*inv_cell_size;
+	const float fy = (p.y - origin.y)*inv_cell_size;
+	const float fz = (p.z - origin.z)*inv_cell_size;
+	if (not (fx >= 0.0f and fx < nx and
+			 fy >= 0.0f and fy < ny and
+			 fz >= 0.0f and fz < nz))
+	{
+		return false;
+	}
+
+	const size_t i = static_cast<size_t>(fx);
+	const size_t j = static_cast<size_t>(fy);
+	const size_t k = static_cast<size_t>(fz);
+	c = (i*ny + j)*nz + k;
+	return true;
+}
+
+// PUBLIC
+
+obstacle_grid::obstacle_grid() {
+	cell_size = 1.0f;
+	inv_cell_size = 1.0f;
+	__pm3_assign_s(origin, 0.0f);
+	nx = ny = nz = 0;
+	cell_start = vector<size_t>(1, 0);
+}
+
+obstacle_grid::~obstacle_grid() {
+	clear();
+}
+
+// MEMORY
+
+void obstacle_grid::init
+(const vector<geometry *>& scene, float d, size_t max_cells)
+{
+	assert(d >= 0.0f);
+	assert(max_cells > 0);
+
+	unbounded.clear();
+	idxs.clear();
+
+	// 1. Region around every bounded object where it may be
+	// within distance 'd' of a point, and region of the grid.
+	static const float inf = numeric_limits<float>::max();
+	vector<vec3> rmins(scene.size()), rmaxs(scene.size());
+	vec3 vmin(inf), vmax(-inf);
+	for (size_t i = 0; i < scene.size(); ++i) {
+		const geometry *g = scene[i];
+		if (unbounded_box(g)) {
+			unbounded.push_back(i);
+			continue;
+		}
+
+		if (g->get_geom_type() == geometry_type::Rectangle) {
+			__pm3_sub_v_s(rmins[i], g->get_min(), d);
+			__pm3_add_v_s(rmaxs[i], g->get_max(), d);
+		}
+		else {
+			const float e = sqrt(d*d + g->approx_radius());
+			const vec3 c = g->get_box_center();
+			__pm3_sub_v_s(rmins[i], c, e);
+			__pm3_add_v_s(rmaxs[i], c, e);
+		}
+		__pm3_min2(vmin, vmin, rmins[i]);
+		__pm3_max2(vmax, vmax, rmaxs[i]);
+	}
+
+	if (unbounded.size() == scene.size()) {
+		// no bounded objects: all points are outside the grid
+		nx = ny = nz = 0;
+		cell_start.assign(1, 0);
+		return;
+	}
+
+	// 2. Size of the cells. The grid has one cell more than
+	// needed in each axis so that it contains the region.
+	__pm3_assign_v(origin, vmin);
+	cell_size = (d > 0.0f ? d : 1.0f);
+	while (true) {
+		inv_cell_size = 1.0f/cell_size;
+		nx = static_cast<size_t>((vmax.x - vmin.x)*inv_cell_size) + 1;
+		ny = static_cast<size_t>((vmax.y - vmin.y)*inv_cell_size) + 1;
+		nz = static_cast<size_t>((vmax.z - vmin.z)*inv_cell_size) + 1;
+		if (double(nx)*double(ny)*double(nz) <= double(max_cells)) {
+			break;
+		}
+		cell_size *= 2.0f;
+	}
+
+	// half the diagonal of a cell, rounded up
+	const float h = 0.87f*cell_size;
+
+	// Calls 'f' with the index of every cell near the i-th object.
+	// The cells are visited in increasing order of index.
+	auto for_each_near =
+	[&](size_t i, const function<void (size_t)>& f) -> void {
+		size_t b[3] = {0, 0, 0};
+		size_t e[3] = {nx - 1, ny - 1, nz - 1};
+		if (not unbounded_box(scene[i])) {
+			const float lo[3] = {rmins[i].x, rmins[i].y, rmins[i].z};
+			const float hi[3] = {rmaxs[i].x, rmaxs[i].y, rmaxs[i].z};
+			const float o[3] = {origin.x, origin.y, origin.z};
+			for (int a = 0; a < 3; ++a) {
+				b[a] = std::min(e[a],
+					static_cast<size_t>(std::max(0.0f, (lo[a] - o[a])*inv_cell_size)));
+				e[a] = std::min(e[a],
+					static_cast<size_t>(std::max(0.0f, (hi[a] - o[a])*inv_cell_size)));
+			}
+		}
+
+		for (size_t x = b[0]; x <= e[0]; ++x) {
+		for (size_t y = b[1]; y <= e[1]; ++y) {
+		for (size_t z = b[2]; z <= e[2]; ++z) {
+			const vec3 c(
+				origin.x + (x + 0.5f)*cell_size,
+				origin.y + (y + 0.5f)*cell_size,
+				origin.z + (z + 0.5f)*cell_size
+			);
+			if (is_near(scene[i], c, d, h)) {
+				f((x*ny + y)*nz + z);
+			}
+		}
+		}
+		}
+	};
+
+	// 3. Count the objects near every cell. The count
+	// of cell 'c' is stored at position c + 1.
+	const size_t n_cells = nx*ny*nz;
+	cell_start.assign(n_cells + 1, 0);
+	for (size_t i = 0; i < scene.size(); ++i) {
+		for_each_near(i, [&](size_t c) -> void { ++cell_start[c + 1]; });
+	}
+
+	// 4. Prefix sum: first position of every cell.
+	for (size_t c = 1; c <= n_cells; ++c) {
+		cell_start[c] += cell_start[c - 1];
+	}
+
+	// 5. Place the indices, in increasing order within every cell.
+	idxs.resize(cell_start[n_cells]);
+	vector<size_t> pos(cell_start.begin(), cell_start.end() - 1);
+	for (size_t i = 0; i < scene.size(); ++i) {
+		for_each_near(i, [&](size_t c) -> void { idxs[pos[c]++] = i; });
+	}
+}
+
+void obstacle_grid::clear() {
+	nx = ny = nz = 0;
+	cell_start.assign(1, 0);
+	idxs.clear();
+	unbounded.clear();
+	cell_start.shrink_to_fit();
+	idxs.shrink_to_fit();
+	unbounded.shrink_to_fit();
+}
+
+// GETTERS
+
+void obstacle_grid::get_indices(const vec3& p, vector<size_t>& res) const {
+	size_t c;
+	if (locate(p, c)) {
+		res.insert(res.end(),
+			idxs.begin() + cell_start[c], idxs.begin() + cell_start[c + 1]);
+	}
+	else {
+		res.insert(res.end(), unbounded.begin(), unbounded.end());
+	}
+}
+
+} // -- namespace structures
+} // -- namespace physim
@@ -0,0 +1,143 @@
+/*********************************************************************
+ * Real-time physics simulation project
+ * Copyright (C) 2018-2019 Lluís Alemany Puig
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ * 
+ * Contact: Lluís Alemany Puig (lluis.alemany.puig@gmail.com)
+ * 
+ ********************************************************************/
+
+#pragma once
+
+// C includes
+#include <stddef.h>
+
+// C++ includes
+#include <vector>
+
+// physim includes
+#include <physim/geometry/geometry.hpp>
+#include <physim/math/vec3.hpp>
+
+namespace physim {
+namespace structures {
+
+/**
+ * @brief Grid of the obstacles near every cell.
+ *
+ * Dense uniform grid of cubic cells over the region around the static
+ * geometry of a simulation. Every cell stores the indices of the
+ * objects that may be within a given distance of some point of the
+ * cell, so that the obstacles near a point are retrieved in constant
+ * time (see @ref get_indices).
+ *
+ * The distance to an object is measured as in the collision avoidance
+ * behaviour of the agent particles (see
+ * @ref particles::agent_particle::collision_avoidance_behaviour):
+ * rectangles and planes are considered walls, and the rest of the
+ * geometry is approximated with spheres. The indices stored are a
+ * superset of the objects within the distance: the caller is expected
+ * to filter them.
+ *
+ * Objects with an unbounded box (see @ref geometric::geometry::get_min),
+ * like planes, may be near any point. Outside the grid only these are
+ * retrieved: bounded objects are too far from the points outside it.
+ *
+ * The grid is meant for static geometry: it has to be rebuilt whenever
+ * the geometry changes.
+ */
+class obstacle_grid {
+	private:
+		/// Length of the side of a cell.
+		float cell_size;
+		/// Inverse of @ref cell_size.
+		float inv_cell_size;
+		/// Origin of the grid.
+		math::vec3 origin;
+		/// Number of cells in each axis.
+		size_t nx, ny, nz;
+
+		/**
+		 * @brief First position in @ref idxs of every cell.
+		 *
+		 * The indices of the objects near the @e c-th cell are those in
+		 * the interval [cell_start[c], cell_start[c + 1]) of @ref idxs.
+		 */
+		std::vector<size_t> cell_start;
+		/// Indices of the objects, sorted by cell.
+		std::vector<size_t> idxs;
+		/// Indices of the objects with an unbounded box.
+		std::vector<size_t> unbounded;
+
+	private:
+
+		/**
+		 * @brief Returns whether object @e g may be within distance @e d
+		 * of a point at distance at most @e h of point @e c.
+		 */
+		static bool is_near
+		(const geometric::geometry *g, const math::vec3& c, float d, float h);
+
+		/**
+		 * @brief Locates a point in the grid.
+		 * @param[in] p Point to be located.
+		 * @param[out] c Index of the cell containing @e p.
+		 * @returns Returns whether @e p is inside the grid or not.
+		 */
+		bool locate(const math::vec3& p, size_t& c) const;
+
+	public:
+		/// Default constructor.
+		obstacle_grid();
+		/// Destructor.
+		~obstacle_grid();
+
+		// MEMORY
+
+		/**
+		 * @brief Builds the grid of a set of objects.
+		 *
+		 * The grid covers the region where bounded objects may be within
+		 * distance @e d. The cells are initially as large as @e d, and
+		 * are made larger until there are at most @e max_cells cells.
+		 * @param scene The geometrical objects.
+		 * @param d Largest distance at which an object is near a point.
+		 * @param max_cells Maximum number of cells.
+		 * @pre @e d >= 0.
+		 * @pre @e max_cells > 0.
+		 */
+		void init(
+			const std::vector<geometric::geometry *>& scene,
+			float d, size_t max_cells = 1 << 18
+		);
+
+		/// Frees the memory occupied by this object.
+		void clear();
+
+		// GETTERS
+
+		/**
+		 * @brief Retrieves the objects near a point.
+		 *
+		 * The indices are appended to @e res in increasing order.
+		 * @param[in] p Point to be located.
+		 * @param[out] res The indices of the objects that may be within
+		 * the distance passed to @ref init of @e p.
+		 */
+		void get_indices(const math::vec3& p, std::vector<size_t>& res) const;
+};
+
+} // -- namespace structures
+} // -- namespace physim
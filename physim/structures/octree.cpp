@@ -95,6 +95,31 @@ inline bool aab_intersects_s
 	return __pm3_dist2(closest, p) <= R*R;
 }
 
+// a cell with 'n' vertices in the box [vmin,vmax] is not partitioned
+inline bool leaf_cell
+(size_t n, const physim::math::vec3& vmin, const physim::math::vec3& vmax, size_t lod)
+{
+	return n <= lod or __pm3_dist2(vmin, vmax) <= 1.0e-5f;
+}
+
+// number of levels of the octree whose subtrees are built in their
+// own task when using 'nt' threads: enough to have several tasks
+// per thread
+inline size_t task_levels(size_t nt) {
+	size_t levels = 0;
+	size_t tasks = 1;
+	while (nt > 1 and tasks < 4*nt) {
+		tasks *= 8;
+		++levels;
+	}
+	return levels;
+}
+
+// marks of the indices reported by the queries made by each thread
+static thread_local vector<unsigned int> query_marks;
+// stamp of the last query made by each thread
+static thread_local unsigned int query_stamp = 0;
+
 template<class T>
 inline void make_unique(vector<T>& v) {
 	std::sort(v.begin(), v.end());
@@ -110,51 +135,9 @@ namespace structures {
 
 // PRIVATE
 
-// -- node
-
-octree::node::node() {
-	idxs = nullptr;
-	count = 0;
-	leaf = false;
-	for (unsigned char i = 0; i < 8; ++i) {
-		children[i] = nullptr;
-	}
-}
-
-octree::node::~node() {
-	if (idxs != nullptr) {
-		free(idxs);
-		idxs = nullptr;
-		count = 0;
-	}
-
-	for (unsigned char i = 0; i < 8; ++i) {
-		if (children[i] != nullptr) {
-			delete children[i];
-			children[i] = nullptr;
-		}
-	}
-}
-
-size_t *octree::node::begin_idxs() {
-	return &idxs[0];
-}
-const size_t *octree::node::begin_idxs() const {
-	return &idxs[0];
-}
-size_t *octree::node::end_idxs() {
-	return &idxs[count - 1] + 1;
-}
-const size_t *octree::node::end_idxs() const {
-	return &idxs[count - 1] + 1;
-}
-
-// PRIVATE
-
-// -- octree
-
-octree::node *octree::make_octree_triangles(
-	size_t lod,
+void octree::make_octree_triangles(
+	vector<node>& ns, vector<uint32_t>& is,
+	size_t n_idx, size_t levels, size_t lod,
 	const vec3& vmin, const vec3& vmax,
 	const vector<vec3>& vertices,
 	const vector<size_t>& triangles,
@@ -164,90 +147,76 @@ octree::node *octree::make_octree_triangles(
 )
 const
 {
+	__pm3_assign_v(ns[n_idx].vmin, vmin);
+	__pm3_assign_v(ns[n_idx].vmax, vmax);
+
 	// If there are less than 8 vertices to be partitioned
 	// then we store the triangle indices and stop here.
-	if (v_idxs.size() <= lod or __pm3_dist2(vmin, vmax) <= 1.0e-5f) {
-
-		// make a new node only if there are enough vertices to store
-		if (t_idxs.size() > 0) {
-			node *n = new node();
-
-			// set minimum and maximum points
-			__pm3_assign_v(n->vmin, vmin);
-			__pm3_assign_v(n->vmax, vmax);
-			// make center point
-			__pm3_add_v_v_div_s(n->center, n->vmin, n->vmax, 2.0f);
-
-			n->leaf = true;
-			n->count = t_idxs.size();
-
-			size_t bytes = n->count*sizeof(size_t);
-			n->idxs = static_cast<size_t *>(malloc(bytes));
-			n->idxs = static_cast<size_t *>(memcpy(n->idxs, &t_idxs[0], bytes));
-			return n;
-		}
-
-		return nullptr;
+	if (leaf_cell(v_idxs.size(), vmin, vmax, lod)) {
+		// this node is made only if there are triangles to store
+		ns[n_idx].leaf = true;
+		ns[n_idx].children = 0;
+		ns[n_idx].first = static_cast<uint32_t>(is.size());
+		ns[n_idx].count = static_cast<uint32_t>(t_idxs.size());
+		is.insert(is.end(), t_idxs.begin(), t_idxs.end());
+		return;
 	}
 
-	node *n = new node();
-	// set minimum and maximum points
-	__pm3_assign_v(n->vmin, vmin);
-	__pm3_assign_v(n->vmax, vmax);
 	// make center point
-	__pm3_add_v_v_div_s(n->center, n->vmin, n->vmax, 2.0f);
+	vec3 center;
+	__pm3_add_v_v_div_s(center, vmin, vmax, 2.0f);
 
 	// Points defining the 12 'rectangles' that
 	// partition this subspace.
 	// Meaning of letters:
 	//		m: minimum, c: average, M: maximum
 	// top level: maximum Z
-	const vec3 cmM(n->center.x, vmin.y, vmax.z);
-	const vec3 mcM(vmin.x, n->center.y, vmax.z);
-	const vec3 cMM(n->center.x, vmax.y, vmax.z);
-	const vec3 McM(vmax.x, n->center.y, vmax.z);
-	const vec3 ccM(n->center.x, n->center.y, vmax.z);
+	const vec3 cmM(center.x, vmin.y, vmax.z);
+	const vec3 mcM(vmin.x, center.y, vmax.z);
+	const vec3 cMM(center.x, vmax.y, vmax.z);
+	const vec3 McM(vmax.x, center.y, vmax.z);
+	const vec3 ccM(center.x, center.y, vmax.z);
 	// mid level: mid Z
-	const vec3 cmc(n->center.x, vmin.y, n->center.z);
-	const vec3 mcc(vmin.x, n->center.y, n->center.z);
-	const vec3 cMc(n->center.x, vmax.y, n->center.z);
-	const vec3 Mcc(vmax.x, n->center.y, n->center.z);
-	const vec3 mMc(vmin.x, vmax.y, n->center.z);
-	const vec3 MMc(vmax.x, vmax.y, n->center.z);
-	const vec3 Mmc(vmax.x, vmin.y, n->center.z);
-	const vec3 mmc(vmin.x, vmin.y, n->center.z);
+	const vec3 cmc(center.x, vmin.y, center.z);
+	const vec3 mcc(vmin.x, center.y, center.z);
+	const vec3 cMc(center.x, vmax.y, center.z);
+	const vec3 Mcc(vmax.x, center.y, center.z);
+	const vec3 mMc(vmin.x, vmax.y, center.z);
+	const vec3 MMc(vmax.x, vmax.y, center.z);
+	const vec3 Mmc(vmax.x, vmin.y, center.z);
+	const vec3 mmc(vmin.x, vmin.y, center.z);
 	// low level: minimum Z
-	const vec3 cmm(n->center.x, vmin.y, vmin.z);
-	const vec3 mcm(vmin.x, n->center.y, vmin.z);
-	const vec3 cMm(n->center.x, vmax.y, vmin.z);
-	const vec3 Mcm(vmax.x, n->center.y, vmin.z);
-	const vec3 ccm(n->center.x, n->center.y, vmin.z);
+	const vec3 cmm(center.x, vmin.y, vmin.z);
+	const vec3 mcm(vmin.x, center.y, vmin.z);
+	const vec3 cMm(center.x, vmax.y, vmin.z);
+	const vec3 Mcm(vmax.x, center.y, vmin.z);
+	const vec3 ccm(center.x, center.y, vmin.z);
 
 	// rectangles at upper half
-	const rectangle rt1(ccM, mcM, mcc, n->center);
-	const rectangle rt2(ccM, cMM, cMc, n->center);
-	const rectangle rt3(ccM, McM, Mcc, n->center);
-	const rectangle rt4(ccM, cmM, cmc, n->center);
+	const rectangle rt1(ccM, mcM, mcc, center);
+	const rectangle rt2(ccM, cMM, cMc, center);
+	const rectangle rt3(ccM, McM, Mcc, center);
+	const rectangle rt4(ccM, cmM, cmc, center);
 	// rectangles at division plane
-	const rectangle rm1(mcc, mMc, cMc, n->center);
-	const rectangle rm2(cMc, MMc, Mcc, n->center);
-	const rectangle rm3(Mcc, Mmc, cmc, n->center);
-	const rectangle rm4(cmc, mmc, mcc, n->center);
+	const rectangle rm1(mcc, mMc, cMc, center);
+	const rectangle rm2(cMc, MMc, Mcc, center);
+	const rectangle rm3(Mcc, Mmc, cmc, center);
+	const rectangle rm4(cmc, mmc, mcc, center);
 	// rectangles at lower half
-	const rectangle rb1(ccm, mcm, mcc, n->center);
-	const rectangle rb2(ccm, cMm, cMc, n->center);
-	const rectangle rb3(ccm, Mcm, Mcc, n->center);
-	const rectangle rb4(ccm, cmm, cmc, n->center);
+	const rectangle rb1(ccm, mcm, mcc, center);
+	const rectangle rb2(ccm, cMm, cMc, center);
+	const rectangle rb3(ccm, Mcm, Mcc, center);
+	const rectangle rb4(ccm, cmm, cmc, center);
 	auto intersections_rectangle =
 	[&](const rectangle& r, size_t v1, size_t v2, bool i[8]) -> void {
 		if (r.intersec_segment(vertices[v1], vertices[v2])) {
 			unsigned char sub;
 
 			sub = 0;
-			__pm3_lt(sub, vertices[v1], n->center);
+			__pm3_lt(sub, vertices[v1], center);
 			i[sub] = true;
 			sub = 0;
-			__pm3_lt(sub, vertices[v2], n->center);
+			__pm3_lt(sub, vertices[v2], center);
 			i[sub] = true;
 		}
 	};
@@ -292,10 +261,10 @@ const
 		const vec3& v = vertices[v_idx];
 
 		unsigned char s = 0;
-		__pm3_lt(s, v, n->center);
+		__pm3_lt(s, v, center);
 
 		// s contains in its three lowest-weight bits the
-		// result of comparing v < n->center.
+		// result of comparing v < center.
 		// This points us to one of the node's children.
 
 		// vertex at position 'v_idx' is
@@ -355,35 +324,91 @@ const
 	// free unused memory
 	subspace_per_vertex.clear();
 
-	vec3 submin, submax;
-
-	// 3. Partition the subspaces
+	// 3. Partition the subspaces. The children that are
+	// made are stored next to each other.
+	vec3 submin[8], submax[8];
+	unsigned char children = 0;
+	unsigned char n_children = 0;
 	for (unsigned char i = 0; i < 8; ++i) {
 
 		// make minimum and maximum points for the i-th child
-		if ((i & 0x01) == 0) { submax.x = n->vmax.x; submin.x = n->center.x; }
-		else				 { submax.x = n->center.x; submin.x = n->vmin.x; }
-		if ((i & 0x02) == 0) { submax.y = n->vmax.y; submin.y = n->center.y; }
-		else				 { submax.y = n->center.y; submin.y = n->vmin.y; }
-		if ((i & 0x04) == 0) { submax.z = n->vmax.z; submin.z = n->center.z; }
-		else				 { submax.z = n->center.z; submin.z = n->vmin.z; }
-
-		n->children[i] =
-		make_octree_triangles(
-			lod, submin, submax,
-			vertices, triangles, tris_per_vertex,
-			vert_idxs_space[i], tris_idxs_space[i]
-		);
+		if ((i & 0x01) == 0) { submax[i].x = vmax.x; submin[i].x = center.x; }
+		else				 { submax[i].x = center.x; submin[i].x = vmin.x; }
+		if ((i & 0x02) == 0) { submax[i].y = vmax.y; submin[i].y = center.y; }
+		else				 { submax[i].y = center.y; submin[i].y = vmin.y; }
+		if ((i & 0x04) == 0) { submax[i].z = vmax.z; submin[i].z = center.z; }
+		else				 { submax[i].z = center.z; submin[i].z = vmin.z; }
+
+		// leaves without triangles are not made
+		if (tris_idxs_space[i].size() > 0 or
+			not leaf_cell(vert_idxs_space[i].size(), submin[i], submax[i], lod))
+		{
+			children |= (1 << i);
+			++n_children;
+		}
+	}
 
-		// free unused memory
-		vert_idxs_space[i].clear();
-		tris_idxs_space[i].clear();
+	const size_t first = ns.size();
+	ns.resize(ns.size() + n_children);
+	ns[n_idx].leaf = false;
+	ns[n_idx].children = children;
+	ns[n_idx].first = static_cast<uint32_t>(first);
+	ns[n_idx].count = 0;
+
+	if (levels == 0) {
+		size_t c = first;
+		for (unsigned char i = 0; i < 8; ++i) {
+			if ((children >> i) & 0x01) {
+				make_octree_triangles(
+					ns, is, c, 0, lod, submin[i], submax[i],
+					vertices, triangles, tris_per_vertex,
+					vert_idxs_space[i], tris_idxs_space[i]
+				);
+				++c;
+			}
+
+			// free unused memory
+			vert_idxs_space[i].clear();
+			tris_idxs_space[i].clear();
+		}
+		return;
 	}
 
-	return n;
+	// build every subtree in its own task, in its
+	// own arrays, and append them to this tree
+	vector<node> sub_ns[8];
+	vector<uint32_t> sub_is[8];
+	for (unsigned char i = 0; i < 8; ++i) {
+		if ((children >> i) & 0x01) {
+			#pragma omp task default(shared) firstprivate(i)
+			{
+			sub_ns[i].resize(1);
+			make_octree_triangles(
+				sub_ns[i], sub_is[i], 0, levels - 1, lod, submin[i], submax[i],
+				vertices, triangles, tris_per_vertex,
+				vert_idxs_space[i], tris_idxs_space[i]
+			);
+
+			// free unused memory
+			vert_idxs_space[i].clear();
+			tris_idxs_space[i].clear();
+			}
+		}
+	}
+	#pragma omp taskwait
+
+	size_t c = first;
+	for (unsigned char i = 0; i < 8; ++i) {
+		if ((children >> i) & 0x01) {
+			append_tree(ns, is, c, sub_ns[i], sub_is[i]);
+			++c;
+		}
+	}
 }
 
-octree::node *octree::make_octree_vertices(
+void octree::make_octree_vertices(
+	vector<node>& ns, vector<uint32_t>& is,
+	size_t n_idx, size_t levels,
 	const void *it, size_t offset,
 	const vec3& vmin, const vec3& vmax,
 	const vector<size_t>& v_idxs,
@@ -391,37 +416,24 @@ octree::node *octree::make_octree_vertices(
 )
 const
 {
+	__pm3_assign_v(ns[n_idx].vmin, vmin);
+	__pm3_assign_v(ns[n_idx].vmax, vmax);
+
 	// If there are less than 8 vertices to be partitioned
 	// then we store the vertex indices and stop here.
-	if (v_idxs.size() <= lod or __pm3_dist2(vmin, vmax) <= 1.0e-5f) {
-
-		// make a new node only if there are enough vertices to store
-		if (v_idxs.size() > 0) {
-			node *n = new node();
-
-			// set minimum and maximum points
-			__pm3_assign_v(n->vmin, vmin);
-			__pm3_assign_v(n->vmax, vmax);
-			// make center point
-			__pm3_add_v_v_div_s(n->center, n->vmin, n->vmax, 2.0f);
-
-			n->leaf = true;
-			n->count = v_idxs.size();
-			size_t bytes = n->count*sizeof(size_t);
-			n->idxs = static_cast<size_t *>(malloc(bytes));
-			n->idxs = static_cast<size_t *>(memcpy(n->idxs, &v_idxs[0], bytes));
-			return n;
-		}
-
-		return nullptr;
+	if (leaf_cell(v_idxs.size(), vmin, vmax, lod)) {
+		// cells without vertices are empty leaves
+		ns[n_idx].leaf = true;
+		ns[n_idx].children = 0;
+		ns[n_idx].first = static_cast<uint32_t>(is.size());
+		ns[n_idx].count = static_cast<uint32_t>(v_idxs.size());
+		is.insert(is.end(), v_idxs.begin(), v_idxs.end());
+		return;
 	}
 
-	node *n = new node();
-	// set minimum and maximum points
-	__pm3_assign_v(n->vmin, vmin);
-	__pm3_assign_v(n->vmax, vmax);
 	// make center point
-	__pm3_add_v_v_div_s(n->center, n->vmin, n->vmax, 2.0f);
+	vec3 center;
+	__pm3_add_v_v_div_s(center, vmin, vmax, 2.0f);
 
 	// vert_idxs_space contains indices pointing to vertices
 	// in parameter 'vertices'. These are the vertices that
@@ -437,10 +449,10 @@ const
 		const vec3 *vvec = static_cast<const vec3 *>(v);
 
 		unsigned char s = 0;
-		__pm3_lt(s, *vvec, n->center);
+		__pm3_lt(s, *vvec, center);
 
 		// s contains in its three lowest-weight bits the
-		// result of comparing v < n->center.
+		// result of comparing v < center.
 		// This points us to one of the node's children.
 
 		// vertex at position 'v_idx' is
@@ -448,110 +460,185 @@ const
 		vert_idxs_space[s].push_back(v_idx);
 	}
 
-	vec3 submin, submax;
+	// 3. Partition the subspaces. All the children are
+	// made, and are stored next to each other.
+	const size_t first = ns.size();
+	ns.resize(ns.size() + 8);
+	ns[n_idx].leaf = false;
+	ns[n_idx].children = 0xff;
+	ns[n_idx].first = static_cast<uint32_t>(first);
+	ns[n_idx].count = 0;
 
-	// 3. Partition the subspaces
+	vec3 submin[8], submax[8];
 	for (unsigned char i = 0; i < 8; ++i) {
-
 		// make minimum and maximum points for the i-th child
-		if ((i & 0x01) == 0) { submax.x = n->vmax.x; submin.x = n->center.x; }
-		else				 { submax.x = n->center.x; submin.x = n->vmin.x; }
-		if ((i & 0x02) == 0) { submax.y = n->vmax.y; submin.y = n->center.y; }
-		else				 { submax.y = n->center.y; submin.y = n->vmin.y; }
-		if ((i & 0x04) == 0) { submax.z = n->vmax.z; submin.z = n->center.z; }
-		else				 { submax.z = n->center.z; submin.z = n->vmin.z; }
+		if ((i & 0x01) == 0) { submax[i].x = vmax.x; submin[i].x = center.x; }
+		else				 { submax[i].x = center.x; submin[i].x = vmin.x; }
+		if ((i & 0x02) == 0) { submax[i].y = vmax.y; submin[i].y = center.y; }
+		else				 { submax[i].y = center.y; submin[i].y = vmin.y; }
+		if ((i & 0x04) == 0) { submax[i].z = vmax.z; submin[i].z = center.z; }
+		else				 { submax[i].z = center.z; submin[i].z = vmin.z; }
+	}
+
+	if (levels == 0) {
+		for (unsigned char i = 0; i < 8; ++i) {
+			make_octree_vertices(
+				ns, is, first + i, 0,
+				it, offset, submin[i], submax[i], vert_idxs_space[i], lod
+			);
 
-		n->children[i] = make_octree_vertices
-		(it, offset, submin, submax, vert_idxs_space[i], lod);
+			// free unused memory
+			vert_idxs_space[i].clear();
+		}
+		return;
+	}
+
+	// build every subtree in its own task, in its
+	// own arrays, and append them to this tree
+	vector<node> sub_ns[8];
+	vector<uint32_t> sub_is[8];
+	for (unsigned char i = 0; i < 8; ++i) {
+		#pragma omp task default(shared) firstprivate(i)
+		{
+		sub_ns[i].resize(1);
+		make_octree_vertices(
+			sub_ns[i], sub_is[i], 0, levels - 1,
+			it, offset, submin[i], submax[i], vert_idxs_space[i], lod
+		);
 
 		// free unused memory
 		vert_idxs_space[i].clear();
+		}
 	}
+	#pragma omp taskwait
 
-	return n;
+	for (unsigned char i = 0; i < 8; ++i) {
+		append_tree(ns, is, first + i, sub_ns[i], sub_is[i]);
+	}
 }
 
-octree::node *octree::copy_node(const node *n) const {
-	if (n == nullptr) {
-		return nullptr;
+void octree::append_tree(
+	vector<node>& ns, vector<uint32_t>& is, size_t n,
+	const vector<node>& sub_ns, const vector<uint32_t>& sub_is
+)
+{
+	// the root goes to position n, and the i-th node (i > 0)
+	// goes to position i + node_base
+	const size_t node_base = ns.size() - 1;
+	const size_t idx_base = is.size();
+
+	ns.insert(ns.end(), sub_ns.begin() + 1, sub_ns.end());
+	is.insert(is.end(), sub_is.begin(), sub_is.end());
+	ns[n] = sub_ns[0];
+
+	auto relocate =
+	[&](node& nd) -> void {
+		nd.first += static_cast<uint32_t>(nd.leaf ? idx_base : node_base);
+	};
+	relocate(ns[n]);
+	for (size_t i = node_base + 1; i < ns.size(); ++i) {
+		relocate(ns[i]);
 	}
+}
 
-	node *copy = new node();
-	__pm3_assign_v(copy->center, n->center);
-	__pm3_assign_v(copy->vmin, n->vmin);
-	__pm3_assign_v(copy->vmax, n->vmax);
+size_t octree::locate(const vec3& p) const {
+	if (nodes.size() == 0) {
+		return 0;
+	}
 
-	if (n->leaf) {
-		// this node is a leaf, so no need to copy the children
+	size_t n = 0;
+	while (not nodes[n].leaf and __pm3_inside_box(p, nodes[n].vmin, nodes[n].vmax)) {
+		const vec3 center = nodes[n].center();
 
-		copy->count = n->count;
-		if (copy->count > 0) {
-			size_t bytes = n->count*sizeof(size_t);
-			copy->idxs = static_cast<size_t *>(malloc(bytes));
-			copy->idxs = static_cast<size_t *>
-					(memcpy(copy->idxs, n->begin_idxs(), bytes));
+		unsigned char s = 0;
+		__pm3_lt(s, p, center);
+		if (not nodes[n].has_child(s)) {
+			return nodes.size();
 		}
-		return copy;
+		n = nodes[n].child(s);
 	}
 
-	for (unsigned char i = 0; i < 8; ++i) {
-		copy->children[i] = copy_node(n->children[i]);
+	if (not nodes[n].leaf or not __pm3_inside_box(p, nodes[n].vmin, nodes[n].vmax)) {
+		return nodes.size();
 	}
-	return copy;
+	return n;
 }
 
-void octree::get_boxes_node
-(const node *n, vector<std::pair<vec3, vec3> >& boxes)
-const
-{
-	if (n == nullptr) {
-		return;
-	}
-	if (n->leaf) {
-		boxes.push_back(make_pair(n->vmin, n->vmax));
-		return;
-	}
-
-	for (unsigned char c = 0; c < 8; ++c) {
-		get_boxes_node(n->children[c], boxes);
+const octree::node *octree::find_leaf(const vec3& p) const {
+	const size_t n = locate(p);
+	if (n == nodes.size() or nodes[n].count == 0) {
+		return nullptr;
 	}
+	return &nodes[n];
 }
 
-void octree::get_indices_node
-(const vec3& p, float R, const node *n, vector<size_t>& idxs) const
-{
-	if (n == nullptr) {
-		return;
+octree::stamps octree::new_query() const {
+	if (query_marks.size() < n_idxs) {
+		query_marks.resize(n_idxs, 0);
 	}
 
-	// if the sphere does not intersect the larger box it
-	// certainly won't intersect the smaller boxes
-	if (not aab_intersects_s(p,R, n->vmin, n->vmax)) {
-		return;
+	++query_stamp;
+	if (query_stamp == 0) {
+		// the stamps wrapped around: clear the old marks
+		std::fill(query_marks.begin(), query_marks.end(), 0);
+		query_stamp = 1;
 	}
 
-	// this cell is intersected by the sphere
+	stamps s;
+	s.marks = query_marks.data();
+	s.stamp = query_stamp;
+	return s;
+}
+
+bool octree::box_intersects_sphere
+(const vec3& p, float R, const vec3& vmin, const vec3& vmax)
+{
+	return aab_intersects_s(p,R, vmin,vmax);
+}
 
-	// if this node is a leaf, 'return' the indices stored in it
-	if (n->leaf) {
-		if (n->count > 0) {
-			idxs.insert(idxs.end(), n->begin_idxs(), n->end_idxs());
+bool octree::box_intersects_segment(
+	const vec3& p, const vec3& d,
+	const vec3& vmin, const vec3& vmax,
+	float& t, float& te
+)
+{
+	// interval of values of t of the
+	// segment that lies inside the box
+	float t0 = 0.0f;
+	float t1 = 1.0f;
+
+	// clip the interval with the slab of one axis
+	auto clip =
+	[&](float pc, float dc, float m, float M) -> bool {
+		if (dc == 0.0f) {
+			// the segment is parallel to the slab
+			return m <= pc and pc <= M;
 		}
-		return;
-	}
+		float tn = (m - pc)/dc;
+		float tf = (M - pc)/dc;
+		if (tn > tf) {
+			std::swap(tn, tf);
+		}
+		t0 = std::max(t0, tn);
+		t1 = std::min(t1, tf);
+		return t0 <= t1;
+	};
 
-	// if the node is not a leaf, check the children
-	for (unsigned char c = 0; c < 8; ++c) {
-		// the intersection with each child's box will be
-		// tested in the call for each child
-		get_indices_node(p, R, n->children[c], idxs);
+	if (clip(p.x, d.x, vmin.x, vmax.x) and
+		clip(p.y, d.y, vmin.y, vmax.y) and
+		clip(p.z, d.z, vmin.z, vmax.z))
+	{
+		t = t0;
+		te = t1;
+		return true;
 	}
+	return false;
 }
 
 // PUBLIC
 
 octree::octree() {
-	root = nullptr;
+	n_idxs = 0;
 }
 
 octree::~octree() {
@@ -563,7 +650,7 @@ octree::~octree() {
 void octree::init(
 	const vector<vec3>& vertices,
 	const vector<size_t>& tris_indices,
-	size_t lod
+	size_t lod, size_t nt
 )
 {
 	clear();
@@ -623,35 +710,34 @@ void octree::init(
 	__pm3_add_acc_s(vmin, -0.01f);
 	__pm3_add_acc_s(vmax, +0.01f);
 
-	root =
-	make_octree_triangles(
-		lod,
-		vmin, vmax, vertices, tris_indices,
-		tris_per_vertex, vert_idxs, tris_idxs
-	);
-}
+	// the indices are stored in 32 bits
+	assert(tris_indices.size() <= numeric_limits<uint32_t>::max());
+	n_idxs = tris_indices.size();
 
-void octree::init(const std::vector<math::vec3>& vertices, size_t lod) {
-	clear();
+	if (tris_idxs.size() > 0 or not leaf_cell(vert_idxs.size(), vmin, vmax, lod)) {
+		nodes.resize(1);
 
-	// axis-aligned bounding box of root
-	static const float inf = numeric_limits<float>::max();
-	vec3 vmin, vmax;
-	__pm3_assign_s(vmin, inf);
-	__pm3_assign_s(vmax, -inf);
-
-	vector<size_t> idxs(vertices.size());
-	for (size_t i = 0; i < vertices.size(); ++i) {
-		__pm3_min2(vmin, vmin, vertices[i]);
-		__pm3_max2(vmax, vmax, vertices[i]);
-		idxs[i] = i;
+		#pragma omp parallel num_threads(nt) if(nt > 1)
+		#pragma omp single
+		make_octree_triangles(
+			nodes, idxs, 0, task_levels(nt), lod,
+			vmin, vmax, vertices, tris_indices,
+			tris_per_vertex, vert_idxs, tris_idxs
+		);
 	}
+}
 
-	root =
-	make_octree_vertices(&vertices[0].x, sizeof(vec3), vmin, vmax, idxs, lod);
+void octree::init(const vector<vec3>& vertices, size_t lod, size_t nt) {
+	if (vertices.size() == 0) {
+		clear();
+		return;
+	}
+	init(&vertices[0].x, vertices.size(), sizeof(vec3), lod, nt);
 }
 
-void octree::init(const void *it, size_t n,size_t offset, size_t lod) {
+void octree::init
+(const void *it, size_t n, size_t offset, size_t lod, size_t nt)
+{
 	clear();
 
 	// axis-aligned bounding box of root
@@ -660,7 +746,7 @@ void octree::init(const void *it, size_t n,size_t offset, size_t lod) {
 	__pm3_assign_s(vmin, inf);
 	__pm3_assign_s(vmax, -inf);
 
-	vector<size_t> idxs(n);
+	vector<size_t> v_idxs(n);
 	const void *iter = it;
 
 	for (size_t i = 0; i < n; ++i) {
@@ -669,65 +755,173 @@ void octree::init(const void *it, size_t n,size_t offset, size_t lod) {
 		// read pack of vec3's
 		__pm3_min2(vmin, vmin, *v_it);
 		__pm3_max2(vmax, vmax, *v_it);
-		idxs[i] = i;
+		v_idxs[i] = i;
 
 		// move iterator to the next vec3
 		iter = static_cast<const void *>
 			(static_cast<const char *>(iter) + offset);
 	}
 
+	// enlarge the box a little so that the points
+	// can move without leaving it (see update)
+	const vec3 pad = (vmax - vmin)*0.05f;
+	vmin = vmin - pad;
+	vmax = vmax + pad;
+
+	// the indices are stored in 32 bits
+	assert(n <= numeric_limits<uint32_t>::max());
+	n_idxs = n;
+
 	// make octree
-	root =
-	make_octree_vertices(it, offset, vmin, vmax, idxs, lod);
+	if (n > 0) {
+		nodes.resize(1);
+
+		#pragma omp parallel num_threads(nt) if(nt > 1)
+		#pragma omp single
+		make_octree_vertices(
+			nodes, idxs, 0, task_levels(nt),
+			it, offset, vmin, vmax, v_idxs, lod
+		);
+	}
 }
 
-void octree::clear() {
-	if (root != nullptr) {
-		delete root;
-		root = nullptr;
+void octree::update
+(const void *it, size_t n, size_t offset, size_t lod, size_t nt)
+{
+	if (nodes.size() == 0 or n != n_idxs) {
+		init(it, n, offset, lod, nt);
+		return;
 	}
-}
 
-void octree::copy(const octree& part) {
-	clear();
-	root = copy_node(part.root);
-}
+	// the i-th point
+	auto point =
+	[&](size_t i) -> const vec3& {
+		return *reinterpret_cast<const vec3 *>
+			(static_cast<const char *>(it) + i*offset);
+	};
 
-// SETTERS
+	// 1. Find the leaf of every point. Only the points
+	// that left their leaf are located from the root.
+	vector<uint32_t> leaf_of(n);
+	bool left = false;
 
-// GETTERS
+	#pragma omp parallel for num_threads(nt) if(nt > 1) reduction(||:left)
+	for (size_t l = 0; l < nodes.size(); ++l) {
+		const node& L = nodes[l];
+		if (not L.leaf) {
+			continue;
+		}
 
-void octree::get_indices(const vec3& p, vector<size_t>& idxs) const {
-	assert(root != nullptr);
+		for (uint32_t k = L.first; k < L.first + L.count; ++k) {
+			const uint32_t i = idxs[k];
+			if (__pm3_inside_box(point(i), L.vmin, L.vmax)) {
+				leaf_of[i] = static_cast<uint32_t>(l);
+				continue;
+			}
 
-	node *n = root;
-	while (n != nullptr and not n->leaf and __pm3_inside_box(p, n->vmin, n->vmax)) {
-		unsigned char s = 0;
-		__pm3_lt(s, p, n->center);
-		n = n->children[s];
+			const size_t m = locate(point(i));
+			if (m == nodes.size()) {
+				left = true;
+			}
+			else {
+				leaf_of[i] = static_cast<uint32_t>(m);
+			}
+		}
 	}
 
-	if (n == nullptr) {
+	if (left) {
+		// some point left the octree
+		init(it, n, offset, lod, nt);
 		return;
 	}
 
-	if (__pm3_inside_box(p, n->vmin, n->vmax) and n->count > 0) {
-		idxs.insert(idxs.end(),
-					n->begin_idxs(),
-					n->end_idxs());
+	// 2. Count the points in every leaf.
+	for (node& L : nodes) {
+		if (L.leaf) {
+			L.count = 0;
+		}
+	}
+	for (size_t i = 0; i < n; ++i) {
+		++nodes[leaf_of[i]].count;
+	}
+
+	// 3. First position of every leaf. Check that
+	// the leaves did not get too many points.
+	uint32_t first = 0;
+	for (node& L : nodes) {
+		if (not L.leaf) {
+			continue;
+		}
+		if (not leaf_cell(L.count, L.vmin, L.vmax, 2*lod)) {
+			init(it, n, offset, lod, nt);
+			return;
+		}
+
+		L.first = first;
+		first += L.count;
+		L.count = 0;
+	}
+
+	// 4. Place the indices.
+	for (size_t i = 0; i < n; ++i) {
+		node& L = nodes[leaf_of[i]];
+		idxs[L.first + L.count] = static_cast<uint32_t>(i);
+		++L.count;
+	}
+}
+
+void octree::clear() {
+	nodes.clear();
+	idxs.clear();
+	nodes.shrink_to_fit();
+	idxs.shrink_to_fit();
+	n_idxs = 0;
+}
+
+void octree::copy(const octree& part) {
+	nodes = part.nodes;
+	idxs = part.idxs;
+	n_idxs = part.n_idxs;
+}
+
+// SETTERS
+
+// GETTERS
+
+void octree::get_indices(const vec3& p, vector<size_t>& res) const {
+	assert(nodes.size() > 0);
+
+	const node *n = find_leaf(p);
+	if (n != nullptr) {
+		res.insert(res.end(),
+				   idxs.begin() + n->first,
+				   idxs.begin() + n->first + n->count);
 	}
 
 	// indices are extracted from a single cell,
 	// which are guaranteed to contain unique indices.
 }
 
-void octree::get_indices (const vec3& p, float R, vector<size_t>& idxs) const {
-	get_indices_node(p, R, root, idxs);
-	make_unique(idxs);
+void octree::get_indices (const vec3& p, float R, vector<size_t>& res) const {
+	visit_indices(p, R,
+		[&](size_t i) -> bool {
+			res.push_back(i);
+			return false;
+		}
+	);
+	make_unique(res);
+}
+
+size_t octree::get_num_nodes() const {
+	return nodes.size();
 }
 
 void octree::get_boxes(vector<pair<vec3, vec3> >& boxes) const {
-	get_boxes_node(root, boxes);
+	for (const node& n : nodes) {
+		if (n.leaf and n.count > 0) {
+			boxes.push_back(make_pair(n.vmin, n.vmax));
+		}
+	}
 }
 
 // OTHERS
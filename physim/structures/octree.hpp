@@ -21,6 +21,10 @@
 
 #pragma once
 
+// C includes
+#include <assert.h>
+#include <stdint.h>
+
 // C++ includes
 #include <string>
 #include <vector>
@@ -43,6 +47,17 @@ namespace structures {
  * and a set of vertices
  * (see function
  * @ref init(const std::vector<math::vec3>&, size_t) ).
+ *
+ * The octree is stored without pointers: all nodes are stored in a
+ * single array (see @ref nodes), where the children of a node are
+ * next to each other, and the indices stored in the leaves are kept
+ * in a single array (see @ref idxs). The queries traverse the tree
+ * iteratively.
+ *
+ * The octree can be built in parallel: the subtrees of the nodes of
+ * the first levels are built in different OpenMP tasks. The octree
+ * of a cloud of points can also be updated after the points moved
+ * (see @ref update) instead of being built again.
  */
 class octree {
 	private:
@@ -52,44 +67,106 @@ class octree {
 			math::vec3 vmin;
 			/// Points with the maximum coordinate values of the points within.
 			math::vec3 vmax;
-			/// Point at the center of the region this node partitions.
-			math::vec3 center;
 
-			/// Indices to the objects' indices.
-			size_t *idxs;
-			/// Amount of indices stored.
-			size_t count;
+			/**
+			 * @brief First index.
+			 *
+			 * In a leaf, position in @ref idxs of the first index stored.
+			 * Otherwise, position in @ref nodes of the first child. The
+			 * other children follow the first.
+			 */
+			uint32_t first;
+			/// Amount of indices stored in a leaf.
+			uint32_t count;
+			/**
+			 * @brief Children of this node.
+			 *
+			 * The @e c-th bit is set if the @e c-th child exists.
+			 */
+			unsigned char children;
 			/// Is this node a leaf?
 			bool leaf;
 
-			/// Pointers to the children of this node.
-			node *children[8];
-
 			// Functions
 
-			/// Default constructor. Initialises pointers to null.
-			node();
-			/// Destructor.
-			~node();
-
-			/// Returns a pointer to the beginning of @ref idxs.
-			size_t *begin_idxs();
-			/// Returns a constant pointer to the beginning of @ref idxs.
-			const size_t *begin_idxs() const;
-			/// Returns a pointer to the ending of @ref idxs.
-			size_t *end_idxs();
-			/// Returns a constant pointer to the ending of @ref idxs.
-			const size_t *end_idxs() const;
+			/// Returns the point at the center of the region of this node.
+			inline math::vec3 center() const {
+				return (vmin + vmax)/2.0f;
+			}
+			/// Does the @e c-th child exist?
+			inline bool has_child(unsigned char c) const {
+				return (children >> c) & 0x01;
+			}
+			/**
+			 * @brief Returns the position of the @e c-th child in @ref nodes.
+			 * @pre The @e c-th child exists.
+			 */
+			inline uint32_t child(unsigned char c) const {
+				// number of existing children before the c-th
+				unsigned char b = children & ((1 << c) - 1);
+				b = (b & 0x55) + ((b >> 1) & 0x55);
+				b = (b & 0x33) + ((b >> 2) & 0x33);
+				b = (b & 0x0f) + ((b >> 4) & 0x0f);
+				return first + b;
+			}
+		};
+
+		/**
+		 * @brief Marks of the indices reported by a query.
+		 *
+		 * Every index stored in the octree has a mark in an array
+		 * owned by the thread that makes the query. An index has
+		 * already been reported in the current query if its mark
+		 * equals the stamp of the query. Starting a new query only
+		 * requires a new stamp, so that no memory has to be cleared
+		 * nor allocated.
+		 */
+		struct stamps {
+			/// Marks of the indices.
+			unsigned int *marks;
+			/// Stamp of the current query.
+			unsigned int stamp;
+
+			/**
+			 * @brief Marks index @e i.
+			 * @returns Returns true if @e i had not been marked
+			 * in the current query.
+			 */
+			inline bool mark(size_t i) {
+				if (marks[i] == stamp) {
+					return false;
+				}
+				marks[i] = stamp;
+				return true;
+			}
 		};
 
-		/// Root of the octree.
-		node *root;
+		/// Nodes of the tree. The root is the first node.
+		std::vector<node> nodes;
+		/// Indices stored at the leaves, grouped by leaf.
+		std::vector<uint32_t> idxs;
+		/**
+		 * @brief Maximum number of nodes waiting to be visited
+		 * in a traversal.
+		 *
+		 * Traversals are depth-first, so they need at most 7 nodes
+		 * per level of the tree. The size of the cells halves at
+		 * every level, so the tree is never deeper than 64 levels.
+		 */
+		static const size_t stack_size = 7*64 + 1;
+		/// One more than the largest index stored in the octree.
+		size_t n_idxs;
 
 	private:
 
 		/**
 		 * @brief Builds a tree rooted at a node that partitions the triangles
 		 * stored in @e triangles pointed by @e triangle_idxs.
+		 * @param ns The nodes of the tree.
+		 * @param is The indices stored at the leaves of the tree.
+		 * @param n Position in @e ns of the root of the tree.
+		 * @param levels Number of levels whose subtrees are built in
+		 * their own OpenMP task.
 		 * @param lod Threshold value for vertex partition. Below this amount,
 		 * vertices will not be partitioned anymore.
 		 * @param vmin Point with the minimum value coordinates of the
@@ -107,11 +184,10 @@ class octree {
 		 * @param triangle_idxs The list of triangles to incident to the
 		 * node to be created. The indexes in this list are all multiples of 3
 		 * and point to positions (also multiple of 3) in @e triangles.
-		 * @return Returns the root of an octree that partitions the triangles
-		 * in @e triangle_idxs and the points in @e vertices_idxs.
 		 */
-		node *make_octree_triangles(
-			size_t lod,
+		void make_octree_triangles(
+			std::vector<node>& ns, std::vector<uint32_t>& is,
+			size_t n, size_t levels, size_t lod,
 			const math::vec3& vmin, const math::vec3& vmax,
 			const std::vector<math::vec3>& vertices,
 			const std::vector<size_t>& triangles,
@@ -123,6 +199,15 @@ class octree {
 		/**
 		 * @brief Builds a tree rooted at a node that partitions the vertices
 		 * stored in @e vertices pointed by @e vertices_idxs.
+		 *
+		 * The inner nodes have all eight children: the cells without
+		 * vertices are empty leaves, so that the vertices can be moved
+		 * into them (see @ref update).
+		 * @param ns The nodes of the tree.
+		 * @param is The indices stored at the leaves of the tree.
+		 * @param n Position in @e ns of the root of the tree.
+		 * @param levels Number of levels whose subtrees are built in
+		 * their own OpenMP task.
 		 * @param lod Threshold value for vertex partition. Below this amount,
 		 * vertices will not be partitioned anymore.
 		 * @param vmin Point with the minimum value coordinates of the points
@@ -133,10 +218,10 @@ class octree {
 		 * @param offset Size in bytes between consecutive vertices' first
 		 * component.
 		 * @param vertices_idxs The list of vertices to be partitioned.
-		 * @return Returns the root of an octree that partitions the points
-		 * in @e vertices_idxs.
 		 */
-		node *make_octree_vertices(
+		void make_octree_vertices(
+			std::vector<node>& ns, std::vector<uint32_t>& is,
+			size_t n, size_t levels,
 			const void *it, size_t offset,
 			const math::vec3& vmin, const math::vec3& vmax,
 			const std::vector<size_t>& vertices_idxs,
@@ -144,36 +229,78 @@ class octree {
 		) const;
 
 		/**
-		 * @brief Copies a node.
+		 * @brief Appends a tree to another.
 		 *
-		 * Recursively copies a node @e n.
-		 * @param n Node to be copied.
-		 * @return Reference to a node created in this function, a copy of @e n.
+		 * The root of the tree made of @e sub_ns and @e sub_is is
+		 * placed at position @e n of @e ns. The other nodes and the
+		 * indices are appended to @e ns and @e is.
+		 * @param[out] ns The nodes of the tree.
+		 * @param[out] is The indices stored at the leaves of the tree.
+		 * @param[in] n Position of the root of the appended tree.
+		 * @param[in] sub_ns The nodes of the appended tree.
+		 * @param[in] sub_is The indices of the appended tree.
 		 */
-		node *copy_node(const node *n) const;
+		static void append_tree(
+			std::vector<node>& ns, std::vector<uint32_t>& is, size_t n,
+			const std::vector<node>& sub_ns, const std::vector<uint32_t>& sub_is
+		);
 
 		/**
-		 * @brief Returns the bounding boxes of the cells in this octree.
-		 * @param[in] n Node to obtain the boxes from.
-		 * @param[out] boxes The vector contains pairs of elements with points
-		 * the minimum and maximum coordinate values.
+		 * @brief Returns the position of the leaf whose cell contains
+		 * point @e p.
+		 * @param p Point to be located.
+		 * @returns Returns the size of @ref nodes if there is no such leaf.
 		 */
-		void get_boxes_node
-		(const node *n, std::vector<std::pair<math::vec3, math::vec3> >& boxes)
-		const;
+		size_t locate(const math::vec3& p) const;
 
 		/**
-		 * @brief Retrieves the indices stored at those cells intersecting
-		 * a sphere of radius @e R centered at @e p.
-		 * @param[in] p Center of sphere.
-		 * @param[in] R Radius of sphere.
-		 * @param[in] n Node of the tree
-		 * @param[out] idxs List of indices (need not be unique).
+		 * @brief Returns the leaf whose cell contains point @e p.
+		 * @param p Point to be located.
+		 * @returns Returns null if there is no such leaf, or if it is empty.
 		 */
-		void get_indices_node(
+		const node *find_leaf(const math::vec3& p) const;
+
+		/**
+		 * @brief Starts a new query.
+		 *
+		 * The marks belong to the calling thread, so that concurrent
+		 * queries on the same octree do not interfere.
+		 * @returns Returns the marks of the query.
+		 */
+		stamps new_query() const;
+
+		/**
+		 * @brief Axis-aligned box - sphere intersection test.
+		 * @param p Center of sphere.
+		 * @param R Radius of sphere.
+		 * @param vmin Minimum coordinates of the box.
+		 * @param vmax Maximum coordinates of the box.
+		 * @returns Returns true if the sphere intersects the box.
+		 */
+		static bool box_intersects_sphere(
 			const math::vec3& p, float R,
-			const node *n, std::vector<size_t>& idxs
-		) const;
+			const math::vec3& vmin, const math::vec3& vmax
+		);
+
+		/**
+		 * @brief Axis-aligned box - segment intersection test.
+		 *
+		 * Slab test of the segment @e p + t*@e d, for t in [0,1].
+		 * @param[in] p First endpoint of the segment.
+		 * @param[in] d Direction of the segment.
+		 * @param[in] vmin Minimum coordinates of the box.
+		 * @param[in] vmax Maximum coordinates of the box.
+		 * @param[out] t Value of t at which the segment enters the box
+		 * (0 if @e p is inside the box).
+		 * @param[out] te Value of t at which the segment leaves the box
+		 * (1 if @e p + @e d is inside the box).
+		 * @returns Returns true if the segment intersects the box.
+		 */
+		static bool box_intersects_segment(
+			const math::vec3& p, const math::vec3& d,
+			const math::vec3& vmin, const math::vec3& vmax,
+			float& t, float& te
+		);
 
 	public:
 		/// Default constructor.
@@ -192,21 +319,23 @@ class octree {
 		 * three integer values we have a triangle.
 		 * @param lod Level Of Detail: minimum number of vertices needed to
 		 * subdivide a cell.
+		 * @param nt Number of threads.
 		 */
 		void init(
 			const std::vector<math::vec3>& vertices,
 			const std::vector<size_t>& tris_indices,
-			size_t lod = 8
+			size_t lod = 8, size_t nt = 1
 		);
 
 		/**
 		 * @brief Builds the partition of a cloud of points.
 		 * @param vertices The vertices, without repetitions, of the cloud.
 		 * @param lod Level Of Detail: minimum number of vertices per cell.
+		 * @param nt Number of threads.
 		 */
 		void init(
 			const std::vector<math::vec3>& vertices,
-			size_t lod = 8
+			size_t lod = 8, size_t nt = 1
 		);
 
 		/**
@@ -235,12 +364,38 @@ class octree {
 		 *
 		 * init(&b[0].b1.x, 512, sizeof(big))
 		 *
+		 * The cell of the root is slightly larger than the cloud, so
+		 * that the points can move a little without leaving it (see
+		 * @ref update).
+		 *
 		 * @param p Pointer to the first element in which the math::vec3 is allocated.
 		 * @param n Number of math::vec3.
 		 * @param offset Byte offset between math::vec3.
 		 * @param lod Level Of Detail: minimum number of vertices per cell.
+		 * @param nt Number of threads.
 		 */
-		void init(const void *p, size_t n, size_t offset, size_t lod = 8);
+		void init
+		(const void *p, size_t n, size_t offset, size_t lod = 8, size_t nt = 1);
+
+		/**
+		 * @brief Updates the partition of a cloud of points.
+		 *
+		 * The points were partitioned with
+		 * @ref init(const void*, size_t, size_t, size_t, size_t) and
+		 * then moved. The cells of the octree are kept: every point
+		 * that left its cell is moved to the cell that now contains it.
+		 *
+		 * The partition is built again if some point left the octree,
+		 * if the number of points changed, or if some cell ends up with
+		 * more than twice @e lod points.
+		 * @param p Pointer to the first element in which the math::vec3 is allocated.
+		 * @param n Number of math::vec3.
+		 * @param offset Byte offset between math::vec3.
+		 * @param lod Level Of Detail: minimum number of vertices per cell.
+		 * @param nt Number of threads.
+		 */
+		void update
+		(const void *p, size_t n, size_t offset, size_t lod = 8, size_t nt = 1);
 
 		/// Frees the memory occupied by this object.
 		void clear();
@@ -266,11 +421,11 @@ class octree {
 		 * incident to that cell.
 		 *
 		 * @param[in] p Point to be located.
-		 * @param[out] idxs The unique indices of the objectes incident to the
+		 * @param[out] res The unique indices of the objectes incident to the
 		 * cell where @e p is located at.
 		 */
 		void get_indices
-		(const math::vec3& p, std::vector<size_t>& idxs) const;
+		(const math::vec3& p, std::vector<size_t>& res) const;
 
 		/**
 		 * @brief Retrieves the indices of the objects incident to
@@ -281,11 +436,137 @@ class octree {
 		 *
 		 * @param[in] p Center of the sphere.
 		 * @param[in] R Radious of the sphere.
-		 * @param[out] idxs The unique indices of the objectes incident to the
+		 * @param[out] res The unique indices of the objectes incident to the
 		 * cell that intersect the sphere.
 		 */
 		void get_indices
-		(const math::vec3& p, float R, std::vector<size_t>& idxs) const;
+		(const math::vec3& p, float R, std::vector<size_t>& res) const;
+
+		/**
+		 * @brief Visits the indices of the objects incident to
+		 * the cell of a point.
+		 *
+		 * Same as @ref get_indices(const math::vec3&, std::vector<size_t>&)
+		 * but, instead of storing the indices, function @e f is called
+		 * on each of them, and no memory is allocated. The visit stops
+		 * as soon as @e f returns true.
+		 * @param p Point to be located.
+		 * @param f Function with signature bool (size_t).
+		 * @returns Returns true if the visit was stopped by @e f.
+		 */
+		template<class Callback>
+		bool visit_indices(const math::vec3& p, Callback f) const;
+
+		/**
+		 * @brief Visits the indices of the objects incident to
+		 * the cells intersecting a sphere.
+		 *
+		 * Same as @ref get_indices(const math::vec3&, float, std::vector<size_t>&)
+		 * but, instead of storing the indices, function @e f is called
+		 * on each of them, and no memory is allocated. Every index is
+		 * visited once, in no particular order. The visit stops as soon
+		 * as @e f returns true.
+		 *
+		 * Function @e f must not make queries on any octree.
+		 * @param p Center of the sphere.
+		 * @param R Radius of the sphere.
+		 * @param f Function with signature bool (size_t).
+		 * @returns Returns true if the visit was stopped by @e f.
+		 */
+		template<class Callback>
+		bool visit_indices(const math::vec3& p, float R, Callback f) const;
+
+		/**
+		 * @brief Visits the indices of the objects incident to
+		 * the cells intersecting a segment.
+		 *
+		 * The segment is traversed through the octree, so that all
+		 * the cells it crosses are considered no matter how long it is.
+		 * The cells are visited from front to back, that is, in the
+		 * order in which they are found when going from @e p1 to @e p2.
+		 * Every index is visited once. The visit stops as soon as @e f
+		 * returns true.
+		 *
+		 * Function @e f must not make queries on any octree.
+		 * @param p1 First endpoint of the segment.
+		 * @param p2 Second endpoint of the segment.
+		 * @param f Function with signature bool (size_t).
+		 * @returns Returns true if the visit was stopped by @e f.
+		 */
+		template<class Callback>
+		bool visit_segment
+		(const math::vec3& p1, const math::vec3& p2, Callback f) const;
+
+		/**
+		 * @brief Visits the indices of the objects incident to
+		 * the cells intersecting a segment, cell by cell.
+		 *
+		 * Same as
+		 * @ref visit_segment(const math::vec3&, const math::vec3&, Callback) const
+		 * but, after the indices of every cell crossed by the segment
+		 * have been visited, function @e cell_end is called with the
+		 * value of t at which the segment @e p1 + t*(@e p2 - @e p1)
+		 * leaves the cell. The visit stops as soon as @e f or
+		 * @e cell_end return true.
+		 *
+		 * An object incident to several cells is visited only in the
+		 * first of them, so it may intersect the segment beyond the
+		 * cell where it is visited. Used, for example, to find the
+		 * closest object intersected by the segment: the visit can stop
+		 * when the closest intersection found is within the cell.
+		 * @param p1 First endpoint of the segment.
+		 * @param p2 Second endpoint of the segment.
+		 * @param f Function with signature bool (size_t).
+		 * @param cell_end Function with signature bool (float).
+		 * @returns Returns true if the visit was stopped by @e f or by
+		 * @e cell_end.
+		 */
+		template<class Callback, class CellEnd>
+		bool visit_segment(
+			const math::vec3& p1, const math::vec3& p2,
+			Callback f, CellEnd cell_end
+		) const;
+
+		/**
+		 * @brief Returns the number of nodes of this octree.
+		 *
+		 * The nodes are identified by an integer in [0, n), where @e n is
+		 * the value returned. The root is the node 0.
+		 */
+		size_t get_num_nodes() const;
+
+		/**
+		 * @brief Visits the nodes of the tree, children before parents.
+		 *
+		 * Meant to compute values of the nodes from the values of the
+		 * objects stored in them. For every leaf @e n, function @e leaf is
+		 * called on every index @e i stored in it. For every inner node
+		 * @e n, function @e inner is called on every child @e c of @e n,
+		 * after all the calls on the node @e c have been made.
+		 * @param leaf Function with signature void (size_t n, size_t i).
+		 * @param inner Function with signature void (size_t n, size_t c).
+		 */
+		template<class Leaf, class Inner>
+		void visit_nodes_bottom_up(Leaf leaf, Inner inner) const;
+
+		/**
+		 * @brief Visits the nodes of the tree, parents before children.
+		 *
+		 * The tree is traversed depth-first from the root. Function
+		 * @e open is called on every node reached, with the bounding box
+		 * of its cell. If it returns true, the traversal continues in
+		 * the children of the node or, in a leaf, function @e leaf is
+		 * called on the indices stored in it. Otherwise, the subtree of
+		 * the node is skipped.
+		 *
+		 * Used, for example, to approximate the effect of the objects of
+		 * a whole subtree when it is far enough from a point.
+		 * @param open Function with signature
+		 * bool (size_t n, const math::vec3& vmin, const math::vec3& vmax).
+		 * @param leaf Function with signature void (size_t i).
+		 */
+		template<class Open, class Leaf>
+		void visit_nodes(Open open, Leaf leaf) const;
 
 		/**
 		 * @brief Returns the bounding boxes of the cells in this octree.
@@ -298,5 +579,227 @@ class octree {
 		// OTHERS
 };
 
+// PUBLIC
+
+template<class Callback>
+bool octree::visit_indices(const math::vec3& p, Callback f) const {
+	const node *n = find_leaf(p);
+	if (n == nullptr) {
+		return false;
+	}
+
+	// the indices in a cell are unique
+	for (uint32_t i = n->first; i < n->first + n->count; ++i) {
+		if (f(static_cast<size_t>(idxs[i]))) {
+			return true;
+		}
+	}
+	return false;
+}
+
+template<class Callback>
+bool octree::visit_indices(const math::vec3& p, float R, Callback f) const {
+	if (nodes.size() == 0) {
+		return false;
+	}
+
+	stamps s = new_query();
+
+	uint32_t stack[stack_size];
+	size_t top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const node& n = nodes[stack[--top]];
+
+		// if the sphere does not intersect the larger box it
+		// certainly won't intersect the smaller boxes
+		if (not box_intersects_sphere(p,R, n.vmin, n.vmax)) {
+			continue;
+		}
+
+		if (n.leaf) {
+			for (uint32_t i = n.first; i < n.first + n.count; ++i) {
+				if (s.mark(idxs[i]) and f(static_cast<size_t>(idxs[i]))) {
+					return true;
+				}
+			}
+			continue;
+		}
+
+		// push the last child first, so that
+		// the children are visited in order
+		for (unsigned char c = 8; c > 0; --c) {
+			if (n.has_child(c - 1)) {
+				assert(top < stack_size);
+				stack[top++] = n.child(c - 1);
+			}
+		}
+	}
+	return false;
+}
+
+template<class Callback>
+bool octree::visit_segment
+(const math::vec3& p1, const math::vec3& p2, Callback f) const
+{
+	return visit_segment(p1, p2, f, [](float) -> bool { return false; });
+}
+
+template<class Callback, class CellEnd>
+bool octree::visit_segment(
+	const math::vec3& p1, const math::vec3& p2,
+	Callback f, CellEnd cell_end
+) const
+{
+	const math::vec3 d = p2 - p1;
+
+	float t, te;
+	if (nodes.size() == 0 or
+		not box_intersects_segment(p1, d, nodes[0].vmin, nodes[0].vmax, t, te))
+	{
+		return false;
+	}
+
+	stamps s = new_query();
+
+	uint32_t stack[stack_size];
+	size_t top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const node& n = nodes[stack[--top]];
+
+		if (n.leaf) {
+			for (uint32_t i = n.first; i < n.first + n.count; ++i) {
+				if (s.mark(idxs[i]) and f(static_cast<size_t>(idxs[i]))) {
+					return true;
+				}
+			}
+
+			// the segment crosses the leaf: it was tested
+			// when the leaf was pushed onto the stack
+			box_intersects_segment(p1, d, n.vmin, n.vmax, t, te);
+			if (cell_end(te)) {
+				return true;
+			}
+			continue;
+		}
+
+		// children crossed by the segment, sorted
+		// by the value of t at which it enters them
+		uint32_t order[8];
+		float ts[8];
+		unsigned char k = 0;
+		for (unsigned char c = 0; c < 8; ++c) {
+			if (not n.has_child(c)) {
+				continue;
+			}
+			const uint32_t ch = n.child(c);
+			if (not box_intersects_segment
+					(p1, d, nodes[ch].vmin, nodes[ch].vmax, t, te))
+			{
+				continue;
+			}
+
+			unsigned char j = k;
+			while (j > 0 and ts[j - 1] > t) {
+				order[j] = order[j - 1];
+				ts[j] = ts[j - 1];
+				--j;
+			}
+			order[j] = ch;
+			ts[j] = t;
+			++k;
+		}
+
+		// push the farthest child first, so that
+		// the closest child is visited first
+		for (unsigned char j = k; j > 0; --j) {
+			assert(top < stack_size);
+			stack[top++] = order[j - 1];
+		}
+	}
+	return false;
+}
+
+template<class Leaf, class Inner>
+void octree::visit_nodes_bottom_up(Leaf leaf, Inner inner) const {
+	if (nodes.size() == 0) {
+		return;
+	}
+
+	// In the preorder of the tree every node appears before
+	// its children: visit the nodes in the reverse order.
+	std::vector<uint32_t> order;
+	order.reserve(nodes.size());
+
+	uint32_t stack[stack_size];
+	size_t top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const uint32_t n = stack[--top];
+		order.push_back(n);
+		if (nodes[n].leaf) {
+			continue;
+		}
+		for (unsigned char c = 8; c > 0; --c) {
+			if (nodes[n].has_child(c - 1)) {
+				assert(top < stack_size);
+				stack[top++] = nodes[n].child(c - 1);
+			}
+		}
+	}
+
+	for (size_t k = order.size(); k > 0; --k) {
+		const uint32_t n = order[k - 1];
+		const node& nd = nodes[n];
+		if (nd.leaf) {
+			for (uint32_t i = nd.first; i < nd.first + nd.count; ++i) {
+				leaf(static_cast<size_t>(n), static_cast<size_t>(idxs[i]));
+			}
+			continue;
+		}
+		for (unsigned char c = 0; c < 8; ++c) {
+			if (nd.has_child(c)) {
+				inner(static_cast<size_t>(n), static_cast<size_t>(nd.child(c)));
+			}
+		}
+	}
+}
+
+template<class Open, class Leaf>
+void octree::visit_nodes(Open open, Leaf leaf) const {
+	if (nodes.size() == 0) {
+		return;
+	}
+
+	uint32_t stack[stack_size];
+	size_t top = 0;
+	stack[top++] = 0;
+
+	while (top > 0) {
+		const uint32_t n = stack[--top];
+		const node& nd = nodes[n];
+		if (not open(static_cast<size_t>(n), nd.vmin, nd.vmax)) {
+			continue;
+		}
+
+		if (nd.leaf) {
+			for (uint32_t i = nd.first; i < nd.first + nd.count; ++i) {
+				leaf(static_cast<size_t>(idxs[i]));
+			}
+			continue;
+		}
+
+		for (unsigned char c = 8; c > 0; --c) {
+			if (nd.has_child(c - 1)) {
+				assert(top < stack_size);
+				stack[top++] = nd.child(c - 1);
+			}
+		}
+	}
+}
+
 } // -- namespace structures
 } // -- namespace physim